@@ -0,0 +1,557 @@
+// Headless benchmark of the AcidStation and AcidComposer DSP.
+// Build with `make bench`, run `build/acid_bench [seconds] [filter]`, or
+// `build/acid_bench record|check [dir]` for the golden-render regression checks, or
+// `build/acid_bench fuzz [dir] [iterations]` to fuzz the pattern chart parser.
+// The modules are created through their Model and driven through their ports, the same way
+// the engine does it, without a window or an audio device.
+
+#include "Harness.hpp"
+#include "AcidStationCore.hpp"
+#include "PatternIndex.hpp"
+#include "PatternLibrary.hpp"
+#include "PatternParser.hpp"
+#include "RCLowpass.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+static volatile float sink;
+
+struct BenchResult {
+	double seconds;
+	int64_t frames;
+	int channels;
+};
+
+static void report(const std::string& name, float sample_rate, const BenchResult& r) {
+	double ns_frame = r.seconds * 1e9 / r.frames;
+	double ns_sample = ns_frame / r.channels;
+	double samples_per_sec = r.frames * r.channels / r.seconds;
+	// Share of one core needed to run this in real time
+	double load = r.seconds / (r.frames / sample_rate) * 100.0;
+	std::printf("%-28s %7.0f %3d %10.2f %10.2f %12.3f %8.3f%%\n", name.c_str(), sample_rate, r.channels,
+				ns_frame, ns_sample, samples_per_sec * 1e-6, load);
+}
+
+template <typename F>
+static BenchResult timeFrames(int64_t frames, int channels, F f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return {std::chrono::duration<double>(end - start).count(), frames, channels};
+}
+
+// With `oscillator` set, the signal input is the pitch of the built-in oscillator, see AcidStation::Oscillators
+static BenchResult benchStationModule(float sample_rate, int channels, int64_t frames, int oscillator = 0,
+									 bool audio_fm = false) {
+	Module* module = modelAcidStation->createModule();
+	setSampleRate(module, sample_rate);
+
+	json_t* rootJ = json_object();
+	json_object_set_new(rootJ, "oscillator", json_integer(oscillator));
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+
+	Input& signal = module->inputs[findInput(module, "Signal")];
+	Input& gate = module->inputs[findInput(module, "Gate")];
+	Input& accent = module->inputs[findInput(module, "Accent")];
+	Input& fm = module->inputs[findInput(module, "FM")];
+	Output& out = module->outputs[findOutput(module, "Signal")];
+	signal.channels = channels;
+	gate.channels = 1;
+	accent.channels = 1;
+	fm.channels = audio_fm ? channels : 0;
+	out.channels = 1;
+	if (audio_fm)
+		module->params[findParam(module, "FM Amount")].setValue(0.5f);
+
+	Script script(sample_rate);
+	Module::ProcessArgs args;
+	args.sampleRate = sample_rate;
+	args.sampleTime = 1.0f / sample_rate;
+
+	BenchResult r = timeFrames(frames, channels, [&]() {
+		for (int64_t frame = 0; frame < frames; frame++) {
+			for (int c = 0; c < channels; c++)
+				signal.voltages[c] = oscillator ? -2.0f + c / 12.0f : script.saw(frame, c);
+			for (int c = 0; c < fm.channels; c++)
+				fm.voltages[c] = script.saw(frame, c);
+			gate.voltages[0] = script.gate(frame, 0);
+			accent.voltages[0] = script.accent(frame, 0);
+			args.frame = frame;
+			module->process(args);
+			sink = out.voltages[0];
+		}
+	});
+	delete module;
+	return r;
+}
+
+static BenchResult benchComposerModule(float sample_rate, int tracks, int64_t frames) {
+	Module* module = modelAcidComposer->createModule();
+	setSampleRate(module, sample_rate);
+
+	json_t* rootJ = json_object();
+	json_object_set_new(rootJ, "header", json_string("A 16 +0"));
+	json_object_set_new(rootJ, "notes", json_string("C C D#E F G A B C C D E F G A B "));
+	json_object_set_new(rootJ, "octave", json_string("  U  D   U  D   "));
+	json_object_set_new(rootJ, "slideAccent", json_string("A   S A   S A  S A  S  A   S A  "));
+	json_object_set_new(rootJ, "time", json_string("oooo_o-ooo_oo-oo"));
+	json_object_set_new(rootJ, "running", json_true());
+	json_object_set_new(rootJ, "tracks", json_integer(tracks));
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+
+	Input& clock = module->inputs[findInput(module, "Clock")];
+	Output& cv = module->outputs[findOutput(module, "CV")];
+	clock.channels = 1;
+
+	Script script(sample_rate);
+	Module::ProcessArgs args;
+	args.sampleRate = sample_rate;
+	args.sampleTime = 1.0f / sample_rate;
+
+	BenchResult r = timeFrames(frames, tracks, [&]() {
+		for (int64_t frame = 0; frame < frames; frame++) {
+			clock.voltages[0] = script.clock(frame);
+			args.frame = frame;
+			module->process(args);
+			sink = cv.voltages[tracks - 1];
+		}
+	});
+	delete module;
+	return r;
+}
+
+// A composer driving a station, either through cables copied after every frame like the
+// engine does, or played by the station from its own process()
+static BenchResult benchVoiceModules(float sample_rate, int tracks, int64_t frames, bool linked) {
+	Module* composer = modelAcidComposer->createModule();
+	Module* station = modelAcidStation->createModule();
+	setSampleRate(composer, sample_rate);
+	setSampleRate(station, sample_rate);
+
+	json_t* rootJ = json_object();
+	json_object_set_new(rootJ, "header", json_string("A 16 +0"));
+	json_object_set_new(rootJ, "notes", json_string("C C D#E F G A B C C D E F G A B "));
+	json_object_set_new(rootJ, "octave", json_string("  U  D   U  D   "));
+	json_object_set_new(rootJ, "slideAccent", json_string("A   S A   S A  S A  S  A   S A  "));
+	json_object_set_new(rootJ, "time", json_string("oooo_o-ooo_oo-oo"));
+	json_object_set_new(rootJ, "running", json_true());
+	json_object_set_new(rootJ, "tracks", json_integer(tracks));
+	composer->dataFromJson(rootJ);
+	json_decref(rootJ);
+
+	rootJ = json_object();
+	json_object_set_new(rootJ, "polyphonic", json_true());
+	json_object_set_new(rootJ, "playComposer", json_boolean(linked));
+	station->dataFromJson(rootJ);
+	json_decref(rootJ);
+	if (linked) {
+		station->rightExpander.module = composer;
+		composer->leftExpander.module = station;
+	}
+
+	Input& clock = composer->inputs[findInput(composer, "Clock")];
+	Output& gate_out = composer->outputs[findOutput(composer, "Gate")];
+	Output& accent_out = composer->outputs[findOutput(composer, "Accent")];
+	Input& signal = station->inputs[findInput(station, "Signal")];
+	Input& gate_in = station->inputs[findInput(station, "Gate")];
+	Input& accent_in = station->inputs[findInput(station, "Accent")];
+	Output& out = station->outputs[findOutput(station, "Signal")];
+	clock.channels = 1;
+	signal.channels = tracks;
+
+	Script script(sample_rate);
+	Module::ProcessArgs args;
+	args.sampleRate = sample_rate;
+	args.sampleTime = 1.0f / sample_rate;
+
+	BenchResult r = timeFrames(frames, tracks, [&]() {
+		for (int64_t frame = 0; frame < frames; frame++) {
+			clock.voltages[0] = script.clock(frame);
+			for (int c = 0; c < tracks; c++)
+				signal.voltages[c] = script.saw(frame, c);
+			args.frame = frame;
+			composer->process(args);
+			station->process(args);
+			flipExpanderMessages(composer);
+			if (!linked) {
+				gate_in.channels = gate_out.channels;
+				accent_in.channels = accent_out.channels;
+				gate_in.writeVoltages(gate_out.voltages);
+				accent_in.writeVoltages(accent_out.voltages);
+			}
+			sink = out.voltages[0];
+		}
+	});
+	delete station;
+	delete composer;
+	return r;
+}
+
+// Renders the whole core in blocks, with the input streams prepared ahead of time
+static BenchResult benchCore(float sample_rate, int channels, int64_t frames, int oversampling, int drive_mode,
+							 bool accented = true) {
+	const int block = 256;
+	AcidStationCore core;
+	core.setSampleRate(sample_rate);
+	core.polyphonic = true;
+	core.oversampling = oversampling;
+	core.drive_mode = drive_mode;
+	core.accent_patched = accented;
+	core.params.envmod = 0.6f;
+	core.params.res = 0.9f;
+	core.params.drive = 0.5f;
+	core.setNoiseSeed(1);
+	core.reset();
+
+	Script script(sample_rate);
+	std::vector<float> in(frames * channels), gate(frames * channels), accent(frames * channels), out(block * channels);
+	for (int64_t frame = 0; frame < frames; frame++) {
+		for (int c = 0; c < channels; c++) {
+			in[frame * channels + c] = script.saw(frame, c);
+			gate[frame * channels + c] = script.gate(frame, c);
+			accent[frame * channels + c] = accented ? script.accent(frame, c) : 0.0f;
+		}
+	}
+
+	return timeFrames(frames, channels, [&]() {
+		for (int64_t frame = 0; frame < frames; frame += block) {
+			int n = std::min<int64_t>(block, frames - frame);
+			size_t offset = frame * channels;
+			core.process(&in[offset], &gate[offset], &accent[offset], nullptr, nullptr, out.data(), n, channels);
+			sink = out[0];
+		}
+	});
+}
+
+// Stages of the core in isolation, on as many SIMD blocks as the channel count needs
+static BenchResult benchEnvelopes(float sample_rate, int channels, int64_t frames) {
+	int blocks = (channels + 3) / 4;
+	std::vector<Envelope3Generator> envs(blocks);
+	for (auto& env : envs)
+		env.setTimes(AcidStationCore::ATTACK_TIME, 0.5f, 1.0f / sample_rate);
+	Script script(sample_rate);
+	int64_t step_length = (int64_t)script.step_length;
+
+	return timeFrames(frames, channels, [&]() {
+		slime::math::float_simd acc = 0.0f;
+		for (int64_t frame = 0; frame < frames; frame++) {
+			slime::math::float_simd trigger = (frame % step_length == 0) ? slime::math::float_simd::mask() : slime::math::float_simd(0.0f);
+			for (auto& env : envs) {
+				env.trigger(trigger);
+				acc += env.process();
+			}
+		}
+		sink = acc[0];
+	});
+}
+
+static BenchResult benchLadder(float sample_rate, int channels, int64_t frames, int oversampling) {
+	int blocks = (channels + 3) / 4;
+	std::vector<slime::dsp::FourPoleLadderLowpass<slime::math::float_simd>> filters(blocks);
+	for (auto& filter : filters) {
+		filter.reset();
+		filter.setResonance(0.9f);
+		filter.setCutoffFrequency(800.0f);
+	}
+	float delta_time = 1.0f / (sample_rate * oversampling);
+	Script script(sample_rate);
+
+	return timeFrames(frames, channels, [&]() {
+		slime::math::float_simd acc = 0.0f;
+		for (int64_t frame = 0; frame < frames; frame++) {
+			slime::math::float_simd x = script.saw(frame, 0);
+			for (auto& filter : filters) {
+				for (int i = 0; i < oversampling; i++) {
+					filter.process(delta_time, x);
+					acc += filter.lowpass4();
+				}
+			}
+		}
+		sink = acc[0];
+	});
+}
+
+static BenchResult benchDrive(float sample_rate, int channels, int64_t frames, bool adaa) {
+	int blocks = (channels + 3) / 4;
+	std::vector<TanhADAA> saturators(blocks);
+	Script script(sample_rate);
+
+	return timeFrames(frames, channels, [&]() {
+		slime::math::float_simd acc = 0.0f;
+		for (int64_t frame = 0; frame < frames; frame++) {
+			slime::math::float_simd x = script.saw(frame, 0) * 0.5f;
+			for (auto& saturator : saturators) {
+				acc += adaa ? saturator.process(x) : slime::math::tanh_rational5(x);
+			}
+		}
+		sink = acc[0];
+	});
+}
+
+static BenchResult benchOversampler(float sample_rate, int channels, int64_t frames, int factor) {
+	int blocks = (channels + 3) / 4;
+	std::vector<Oversampler<slime::math::float_simd>> oversamplers(blocks);
+	for (auto& oversampler : oversamplers)
+		oversampler.setFactor(factor);
+	Script script(sample_rate);
+
+	return timeFrames(frames, channels, [&]() {
+		slime::math::float_simd acc = 0.0f;
+		slime::math::float_simd buffer[Oversampler<slime::math::float_simd>::MAX_FACTOR];
+		for (int64_t frame = 0; frame < frames; frame++) {
+			slime::math::float_simd x = script.saw(frame, 0);
+			for (auto& oversampler : oversamplers) {
+				oversampler.upsample(x, buffer);
+				acc += oversampler.downsample(buffer);
+			}
+		}
+		sink = acc[0];
+	});
+}
+
+static BenchResult benchNoise(int channels, int64_t frames) {
+	int blocks = (channels + 3) / 4;
+	std::vector<NoiseSimd> noise(blocks);
+	for (int i = 0; i < blocks; i++)
+		noise[i].seed(i);
+
+	return timeFrames(frames, channels, [&]() {
+		slime::math::float_simd acc = 0.0f;
+		for (int64_t frame = 0; frame < frames; frame++) {
+			for (auto& n : noise)
+				acc += n.process();
+		}
+		sink = acc[0];
+	});
+}
+
+// Bulk chart import, parsing random charts written with the editor alphabets
+static void benchParser(double seconds) {
+	const int count = 1024;
+	std::vector<std::string> lines(count * 5);
+	std::mt19937 rng(1);
+	auto random_line = [&](const char* alphabet, int size) {
+		std::string line(size, ' ');
+		for (auto& c : line)
+			c = alphabet[rng() % std::strlen(alphabet)];
+		return line;
+	};
+	size_t bytes = 0;
+	for (int i = 0; i < count; i++) {
+		lines[i * 5 + 0] = std::string(1, 'A' + rng() % 26) + " " + std::to_string(1 + rng() % 16) + " +" + std::to_string(rng() % 12);
+		for (int step = 0; step < 16; step++)
+			lines[i * 5 + 1] += random_line("ABCDEFG ", 1) + random_line("# b", 1);
+		lines[i * 5 + 2] = random_line("DUdu ", 16);
+		lines[i * 5 + 3] = random_line("SAsa ", 32);
+		lines[i * 5 + 4] = random_line("o_- ", 16);
+		for (int l = 0; l < 5; l++)
+			bytes += lines[i * 5 + l].size();
+	}
+
+	int64_t charts = 0;
+	int errors = 0;
+	ComposerPattern pattern;
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0.0;
+	while (elapsed < seconds) {
+		for (int i = 0; i < count; i++) {
+			const std::string* chart = &lines[i * 5];
+			errors += parsePattern(chart[0], chart[1], chart[2], chart[3], chart[4], &pattern).error != PatternParseResult::OK;
+			sink = pattern.notes[0];
+		}
+		charts += count;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::printf("%-28s %10.1f ns/chart %12.3f Mcharts/s %10.1f MB/s (%d errors)\n", "pattern parser", elapsed * 1e9 / charts,
+				charts / elapsed * 1e-6, bytes * (charts / count) / elapsed * 1e-6, errors);
+}
+
+// The float one-pole slide against the WDF reference in double, on a stepped CV that
+// slides half of the time and holds still the other half
+static void benchSlide(double seconds) {
+	const float sample_rate = 48000.0f;
+	const int64_t frames = (int64_t)(seconds * sample_rate);
+	Script script(sample_rate);
+	auto cv = [&](int64_t frame) {
+		int step = script.step(frame, 0);
+		return (step % 2) ? 0.0f : (step % 7) / 12.0f;
+	};
+
+	RCLowpass<float> slide;
+	RCLowpassWDF<double> reference;
+	slide.prepare(sample_rate);
+	reference.prepare(sample_rate);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int64_t frame = 0; frame < frames; frame++)
+		sink = slide.processSample(cv(frame));
+	double slide_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	for (int64_t frame = 0; frame < frames; frame++)
+		sink = (float)reference.processSample(cv(frame));
+	double reference_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// The WDF holds references to its own elements, so it can't be reset by assignment
+	RCLowpassWDF<double> check;
+	check.prepare(sample_rate);
+	slide.reset();
+	double error = 0.0;
+	for (int64_t frame = 0; frame < frames; frame++)
+		error = std::max(error, std::fabs(slide.processSample(cv(frame)) - check.processSample(cv(frame))));
+
+	std::printf("%-28s %10.2f ns/sample, WDF in double %.2f ns/sample, max difference %.2e V\n", "slide filter",
+				slide_time * 1e9 / frames, reference_time * 1e9 / frames, error);
+}
+
+// Opening a library of 100k patterns and loading patterns from it at random, the way the
+// browser does: decode the record to a chart and parse it. Then indexing it and searching
+// for the patterns closest to random ones.
+static void benchLibrary(double seconds) {
+	const int count = 100000;
+	std::vector<PatternRecord> records(count);
+	std::mt19937 rng(1);
+	for (auto& record : records) {
+		std::memset(&record, 0, sizeof(record));
+		std::snprintf(record.name, sizeof(record.name), "pattern %u", (unsigned)rng());
+		record.letter = 'A' + rng() % 26;
+		record.length = 1 + rng() % 16;
+		record.transpose = (int8_t)(rng() % 25) - 12;
+		for (int step = 0; step < ComposerPattern::MAX_STEPS; step++) {
+			record.notes[step] = (int8_t)(rng() % 25) - 12;
+			// Gate with accent and slide, or tie, or rest
+			uint64_t bits = (rng() % 3 == 0) ? PatternRecord::TIE : (rng() % 2) ? PatternRecord::GATE | (rng() % 4) * 2 : 0;
+			record.attributes |= bits << (step * 4);
+		}
+	}
+	std::string path = "acid_bench_library.takp";
+	if (!writePatternLibrary(path, records.data(), count)) {
+		std::printf("Can't write %s\n", path.c_str());
+		return;
+	}
+
+	PatternLibrary library;
+	auto start = std::chrono::steady_clock::now();
+	bool opened = library.open(path);
+	double open_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int64_t loads = 0;
+	int errors = 0;
+	std::string chart[PatternParseResult::LINES_LEN];
+	ComposerPattern pattern;
+	start = std::chrono::steady_clock::now();
+	double elapsed = 0.0;
+	while (opened && elapsed < seconds) {
+		for (int i = 0; i < 1024; i++) {
+			decodePattern(library.record(rng() % library.count), 'A', chart);
+			errors += parsePattern(chart[0], chart[1], chart[2], chart[3], chart[4], &pattern).error != PatternParseResult::OK;
+			sink = pattern.notes[0];
+		}
+		loads += 1024;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	double load_time = elapsed;
+
+	PatternIndex index;
+	start = std::chrono::steady_clock::now();
+	index.build(library);
+	double index_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int64_t queries = 0;
+	int exact = 0;
+	start = std::chrono::steady_clock::now();
+	elapsed = 0.0;
+	while (opened && elapsed < seconds) {
+		int i = rng() % library.count;
+		std::vector<PatternIndex::Match> matches = index.findSimilar(PatternSignature::of(library.record(i)), 20);
+		exact += !matches.empty() && matches[0].distance == 0;
+		queries++;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	library.close();
+	std::remove(path.c_str());
+
+	std::printf("%-28s %10.1f us open for %d patterns, %10.1f ns/load (%d errors)\n", "pattern library", open_time * 1e6,
+				opened ? count : 0, load_time * 1e9 / std::max(loads, (int64_t)1), errors);
+	std::printf("%-28s %10.2f ms index, %10.3f ms/query (%lld of %lld found themselves)\n", "pattern similarity", index_time * 1e3,
+				elapsed * 1e3 / std::max(queries, (int64_t)1), (long long)exact, (long long)queries);
+}
+
+int main(int argc, char** argv) {
+	// Just enough of Rack for modules to be created and processed
+	random::init();
+	contextSet(new Context);
+	APP->engine = new engine::Engine;
+
+	std::string command = (argc > 1) ? argv[1] : "";
+	if (command == "record" || command == "check") {
+		std::string dir = (argc > 2) ? argv[2] : "build/golden";
+		return (command == "record") ? recordGolden(dir) : checkGolden(dir);
+	}
+	if (command == "fuzz") {
+		std::string dir = (argc > 2) ? argv[2] : "bench/fuzz";
+		int iterations = (argc > 3) ? std::atoi(argv[3]) : 1000000;
+		return runFuzz(dir, iterations);
+	}
+
+	double seconds = (argc > 1) ? std::atof(argv[1]) : 10.0;
+	std::string filter = (argc > 2) ? argv[2] : "";
+
+	const float sample_rates[] = {44100.0f, 48000.0f, 96000.0f, 192000.0f};
+	const int channel_counts[] = {1, 4, 8, 16};
+
+	if (filter.empty() || std::string("pattern parser").find(filter) != std::string::npos)
+		benchParser(std::min(seconds, 2.0));
+	if (filter.empty() || std::string("slide filter").find(filter) != std::string::npos)
+		benchSlide(std::min(seconds, 2.0));
+	if (filter.empty() || std::string("pattern library").find(filter) != std::string::npos)
+		benchLibrary(std::min(seconds, 2.0));
+
+	std::printf("Rendering %.1f s per case\n", seconds);
+	std::printf("%-28s %7s %3s %10s %10s %12s %9s\n", "case", "rate", "ch", "ns/frame", "ns/sample", "Msamples/s", "core load");
+
+	auto run = [&](const std::string& name, float sample_rate, std::function<BenchResult()> f) {
+		if (!filter.empty() && name.find(filter) == std::string::npos)
+			return;
+		report(name, sample_rate, f());
+	};
+
+	for (float sample_rate : sample_rates) {
+		int64_t frames = (int64_t)(seconds * sample_rate);
+
+		for (int channels : channel_counts) {
+			run("AcidComposer", sample_rate, [&]() { return benchComposerModule(sample_rate, channels, frames); });
+			run("AcidStation", sample_rate, [&]() { return benchStationModule(sample_rate, channels, frames); });
+			run("AcidStation saw", sample_rate, [&]() { return benchStationModule(sample_rate, channels, frames, 1); });
+			run("AcidStation audio rate FM", sample_rate, [&]() { return benchStationModule(sample_rate, channels, frames, 0, true); });
+			run("composer to station cables", sample_rate, [&]() { return benchVoiceModules(sample_rate, channels, frames, false); });
+			run("composer played by station", sample_rate, [&]() { return benchVoiceModules(sample_rate, channels, frames, true); });
+			run("core", sample_rate, [&]() { return benchCore(sample_rate, channels, frames, 1, AcidStationCore::DRIVE_PLAIN); });
+			run("core without accents", sample_rate, [&]() { return benchCore(sample_rate, channels, frames, 1, AcidStationCore::DRIVE_PLAIN, false); });
+			run("core ADAA", sample_rate, [&]() { return benchCore(sample_rate, channels, frames, 1, AcidStationCore::DRIVE_ADAA); });
+			for (int factor : {2, 4, 8}) {
+				run("core " + std::to_string(factor) + "x", sample_rate, [&]() { return benchCore(sample_rate, channels, frames, factor, AcidStationCore::DRIVE_PLAIN); });
+			}
+
+			// Per-stage breakdown
+			run("  stage envelopes", sample_rate, [&]() { return benchEnvelopes(sample_rate, channels, frames); });
+			run("  stage ladder", sample_rate, [&]() { return benchLadder(sample_rate, channels, frames, 1); });
+			run("  stage tanh_rational5", sample_rate, [&]() { return benchDrive(sample_rate, channels, frames, false); });
+			run("  stage tanh ADAA", sample_rate, [&]() { return benchDrive(sample_rate, channels, frames, true); });
+			run("  stage oversampler 2x", sample_rate, [&]() { return benchOversampler(sample_rate, channels, frames, 2); });
+			run("  stage noise", sample_rate, [&]() { return benchNoise(channels, frames); });
+		}
+	}
+
+	return 0;
+}
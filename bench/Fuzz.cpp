@@ -0,0 +1,174 @@
+// Mutation fuzzing of the pattern chart parser. Every chart in the corpus is mutated at
+// random and parsed, checking that the parser never reads out of bounds (run it under
+// -fsanitize=address for that), that the compiled pattern always stays in range and that
+// recompiling only the edited steps gives the same pattern as compiling the whole chart,
+// and that the pattern survives a round trip through a pattern library record.
+
+#include "Harness.hpp"
+#include "PatternLibrary.hpp"
+#include "PatternParser.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+typedef std::vector<std::string> Chart;
+
+static bool readChart(const std::string& path, Chart* chart) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	chart->assign(PatternParseResult::LINES_LEN, "");
+	for (auto& line : *chart) {
+		if (!std::getline(file, line))
+			break;
+	}
+	return true;
+}
+
+static PatternParseResult parseChart(const Chart& chart, ComposerPattern* pattern) {
+	return parsePattern(chart[0], chart[1], chart[2], chart[3], chart[4], pattern);
+}
+
+static bool samePattern(const ComposerPattern& a, const ComposerPattern& b) {
+	if (a.length != b.length || a.letter != b.letter || a.transpose != b.transpose)
+		return false;
+	for (int i = 0; i < ComposerPattern::MAX_STEPS; i++) {
+		const ComposerStep& x = a.program[i];
+		const ComposerStep& y = b.program[i];
+		if (a.notes[i] != b.notes[i] || a.attributes[i].getAttribute() != b.attributes[i].getAttribute()
+			|| x.cv != y.cv || x.gate != y.gate || x.latch != y.latch || x.accent != y.accent || x.slide != y.slide)
+			return false;
+	}
+	return true;
+}
+
+// Compiles `chart` as an edit of `original`, like the module does
+static void parseEdit(const Chart& original, const Chart& chart, ComposerPattern* pattern) {
+	parseChart(original, pattern);
+	ChartLine before[] = {original[0], original[1], original[2], original[3], original[4]};
+	ChartLine after[] = {chart[0], chart[1], chart[2], chart[3], chart[4]};
+	parsePattern(after[0], after[1], after[2], after[3], after[4], pattern, changedSteps(before, after));
+}
+
+// The pattern played from a library record, whose notes may be spelled differently
+static bool sameAfterLibrary(const Chart& chart, const ComposerPattern& pattern) {
+	ChartLine lines[] = {chart[0], chart[1], chart[2], chart[3], chart[4]};
+	Chart decoded(PatternParseResult::LINES_LEN);
+	decodePattern(encodePattern(lines, pattern, "fuzz"), pattern.letter, decoded.data());
+	ComposerPattern loaded;
+	if (parseChart(decoded, &loaded).error != PatternParseResult::OK)
+		return false;
+	if (loaded.length != pattern.length || loaded.letter != pattern.letter || loaded.transpose != pattern.transpose)
+		return false;
+	for (int i = 0; i < ComposerPattern::MAX_STEPS; i++) {
+		const ComposerStep& x = loaded.program[i];
+		const ComposerStep& y = pattern.program[i];
+		if (std::fabs(loaded.notes[i] - pattern.notes[i]) > 1e-5f || loaded.attributes[i].getAttribute() != pattern.attributes[i].getAttribute()
+			|| std::fabs(x.cv - y.cv) > 1e-5f || x.gate != y.gate || x.latch != y.latch || x.accent != y.accent || x.slide != y.slide)
+			return false;
+	}
+	return true;
+}
+
+static void mutate(Chart& chart, std::mt19937& rng) {
+	std::string& line = chart[rng() % chart.size()];
+	int pos = line.empty() ? 0 : rng() % (line.size() + 1);
+	switch (rng() % 7) {
+		case 0: // random byte
+			if (!line.empty())
+				line[pos % line.size()] = (char)(rng() & 0xff);
+			break;
+		case 1: // byte from the chart alphabet
+			if (!line.empty())
+				line[pos % line.size()] = "ABCDEFGabcdefg#UDudSAsao_- +-0123456789"[rng() % 39];
+			break;
+		case 2: // insertion
+			line.insert(line.begin() + pos, (char)(rng() & 0xff));
+			break;
+		case 3: // deletion
+			if (!line.empty())
+				line.erase(pos % line.size(), 1);
+			break;
+		case 4: // truncation
+			line.resize(pos);
+			break;
+		case 5: // repeated digits, for the length and transpose
+			line.insert(pos, std::string(1 + rng() % 24, '0' + rng() % 10));
+			break;
+		case 6: // swapped lines
+			std::swap(line, chart[rng() % chart.size()]);
+			break;
+	}
+}
+
+static bool checkInvariants(const Chart& chart, const PatternParseResult& result, const ComposerPattern& pattern) {
+	if (result.error < PatternParseResult::OK || result.error >= PatternParseResult::ERRORS_LEN)
+		return false;
+	if (result.line < PatternParseResult::HEADER || result.line >= PatternParseResult::LINES_LEN)
+		return false;
+	if (result.column < 0 || result.column > (int)chart[result.line].size())
+		return false;
+	if (pattern.length < 1 || pattern.length > ComposerPattern::MAX_STEPS)
+		return false;
+	if (!(std::fabs(pattern.transpose) <= 99.0f / 12.0f))
+		return false;
+	for (int i = 0; i < ComposerPattern::MAX_STEPS; i++) {
+		if (!(pattern.notes[i] >= -1.0f - 1.0f / 12.0f && pattern.notes[i] <= 2.0f))
+			return false;
+		if (i >= pattern.length && (pattern.notes[i] != 0.0f || pattern.attributes[i].getAttribute() != 0))
+			return false;
+	}
+
+	// Parsing has to be deterministic
+	ComposerPattern again;
+	PatternParseResult result2 = parseChart(chart, &again);
+	return result2.error == result.error && result2.line == result.line && result2.column == result.column
+		&& std::memcmp(again.notes, pattern.notes, sizeof(pattern.notes)) == 0;
+}
+
+int runFuzz(const std::string& dir, int iterations) {
+	std::vector<Chart> corpus;
+	for (const std::string& path : system::getEntries(dir)) {
+		Chart chart;
+		if (readChart(path, &chart))
+			corpus.push_back(chart);
+	}
+	if (corpus.empty()) {
+		std::printf("No charts in %s\n", dir.c_str());
+		return 1;
+	}
+
+	std::mt19937 rng(1);
+	int failures = 0;
+	int errors[PatternParseResult::ERRORS_LEN] = {};
+	for (int i = 0; i < iterations; i++) {
+		const Chart& original = corpus[rng() % corpus.size()];
+		Chart chart = original;
+		int mutations = 1 + rng() % 8;
+		for (int m = 0; m < mutations; m++)
+			mutate(chart, rng);
+
+		ComposerPattern pattern;
+		PatternParseResult result = parseChart(chart, &pattern);
+		errors[result.error]++;
+		ComposerPattern edited;
+		parseEdit(original, chart, &edited);
+		if (!checkInvariants(chart, result, pattern) || !samePattern(pattern, edited) || !sameAfterLibrary(chart, pattern)) {
+			if (failures++ < 10) {
+				std::printf("Invariant broken:\n");
+				for (auto& line : chart)
+					std::printf("    [%s]\n", line.c_str());
+			}
+		}
+	}
+
+	std::printf("%d charts from %zu seeds, %d failures\n", iterations, corpus.size(), failures);
+	for (int e = 0; e < PatternParseResult::ERRORS_LEN; e++) {
+		PatternParseResult result;
+		result.error = (PatternParseResult::Error)e;
+		std::printf("    %8d %s\n", errors[e], result.message());
+	}
+	return failures ? 1 : 0;
+}
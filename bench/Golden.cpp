@@ -0,0 +1,431 @@
+// Golden-render regression checks. Fixed pattern and parameter scenarios are rendered through
+// both modules and compared against reference renders. Gate and accent edges must land on the
+// same frame, CV must stay within a few cents and audio within an RMS and peak error budget.
+//
+// The renders depend on the compiler, its flags and the dependencies, so references are
+// recorded locally from the tree before a change (`make golden-record`) and checked after it
+// (`make golden`). They don't travel between machines and aren't committed.
+
+#include "Harness.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+static const float AUDIO_RMS_BUDGET = 1e-3f; // relative to the reference RMS, -60dB
+static const float AUDIO_PEAK_BUDGET = 0.05f; // V
+static const float CV_CENTS_BUDGET = 2.0f;
+static const float EDGE_THRESHOLD = 1.0f; // V
+
+struct Render {
+	enum Kind {
+		AUDIO,
+		SEQUENCER // columns are CV, gate, accent
+	};
+
+	Kind kind;
+	float sample_rate;
+	int columns;
+	int64_t frames;
+	std::vector<float> data;
+	double seconds = 0.0;
+};
+
+struct Scenario {
+	std::string name;
+	std::function<Render()> render;
+};
+
+template <typename F>
+static double timeRender(F f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+struct StationSettings {
+	float sample_rate = 48000.0f;
+	int channels = 1;
+	bool polyphonic = false;
+	int oversampling = 1;
+	int drive_mode = 0;
+	bool audio_fm = false; // a second saw into the FM input
+	std::vector<std::pair<const char*, float>> params;
+};
+
+static Render renderStation(const StationSettings& settings, double seconds) {
+	// The filter dither is seeded from the Rack random generator
+	random::local().seed(1, 2);
+	Module* module = modelAcidStation->createModule();
+	setSampleRate(module, settings.sample_rate);
+
+	json_t* rootJ = json_object();
+	json_object_set_new(rootJ, "polyphonic", json_boolean(settings.polyphonic));
+	json_object_set_new(rootJ, "oversampling", json_integer(settings.oversampling));
+	json_object_set_new(rootJ, "driveMode", json_integer(settings.drive_mode));
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+
+	for (auto& param : settings.params)
+		module->params[findParam(module, param.first)].setValue(param.second);
+
+	Input& signal = module->inputs[findInput(module, "Signal")];
+	Input& gate = module->inputs[findInput(module, "Gate")];
+	Input& accent = module->inputs[findInput(module, "Accent")];
+	Input& fm = module->inputs[findInput(module, "FM")];
+	Output& out = module->outputs[findOutput(module, "Signal")];
+	int control_channels = settings.polyphonic ? settings.channels : 1;
+	signal.channels = settings.channels;
+	fm.channels = settings.audio_fm ? settings.channels : 0;
+	gate.channels = control_channels;
+	accent.channels = control_channels;
+	out.channels = 1;
+
+	Render r;
+	r.kind = Render::AUDIO;
+	r.sample_rate = settings.sample_rate;
+	r.columns = settings.channels;
+	r.frames = (int64_t)(seconds * settings.sample_rate);
+	r.data.resize(r.frames * r.columns);
+
+	Script script(settings.sample_rate);
+	Module::ProcessArgs args;
+	args.sampleRate = settings.sample_rate;
+	args.sampleTime = 1.0f / settings.sample_rate;
+
+	r.seconds = timeRender([&]() {
+		for (int64_t frame = 0; frame < r.frames; frame++) {
+			for (int c = 0; c < settings.channels; c++)
+				signal.voltages[c] = script.saw(frame, c);
+			for (int c = 0; c < fm.channels; c++)
+				fm.voltages[c] = script.saw(frame, c + 1);
+			for (int c = 0; c < control_channels; c++) {
+				gate.voltages[c] = script.gate(frame, c);
+				accent.voltages[c] = script.accent(frame, c);
+			}
+			args.frame = frame;
+			module->process(args);
+			std::memcpy(&r.data[frame * r.columns], out.voltages, r.columns * sizeof(float));
+		}
+	});
+	delete module;
+	return r;
+}
+
+struct ComposerSettings {
+	float sample_rate = 48000.0f;
+	std::string header = "A 16 +0";
+	std::string notes, octave, slide_accent, time;
+	float slide_res = 0.0f;
+	float slide_cap = 0.0f;
+	// Song mode: pattern B reuses the chart of A under its own header
+	std::string header_b;
+	std::string chain;
+};
+
+static Render renderComposer(const ComposerSettings& settings, double seconds) {
+	Module* module = modelAcidComposer->createModule();
+	setSampleRate(module, settings.sample_rate);
+
+	json_t* rootJ = json_object();
+	json_t* patternsJ = json_array();
+	for (const std::string& header : {settings.header, settings.header_b}) {
+		if (header.empty())
+			continue;
+		json_t* patternJ = json_object();
+		json_object_set_new(patternJ, "header", json_string(header.c_str()));
+		json_object_set_new(patternJ, "notes", json_string(settings.notes.c_str()));
+		json_object_set_new(patternJ, "octave", json_string(settings.octave.c_str()));
+		json_object_set_new(patternJ, "slideAccent", json_string(settings.slide_accent.c_str()));
+		json_object_set_new(patternJ, "time", json_string(settings.time.c_str()));
+		json_array_append_new(patternsJ, patternJ);
+	}
+	json_object_set_new(rootJ, "patterns", patternsJ);
+	json_object_set_new(rootJ, "chain", json_string(settings.chain.c_str()));
+	json_object_set_new(rootJ, "running", json_true());
+	module->dataFromJson(rootJ);
+	json_decref(rootJ);
+
+	module->params[findParam(module, "Slide resistor")].setValue(settings.slide_res);
+	module->params[findParam(module, "Slide capacitor")].setValue(settings.slide_cap);
+
+	Input& clock = module->inputs[findInput(module, "Clock")];
+	Output& cv = module->outputs[findOutput(module, "CV")];
+	Output& gate = module->outputs[findOutput(module, "Gate")];
+	Output& accent = module->outputs[findOutput(module, "Accent")];
+	clock.channels = 1;
+	cv.channels = 1;
+	gate.channels = 1;
+	accent.channels = 1;
+
+	Render r;
+	r.kind = Render::SEQUENCER;
+	r.sample_rate = settings.sample_rate;
+	r.columns = 3;
+	r.frames = (int64_t)(seconds * settings.sample_rate);
+	r.data.resize(r.frames * r.columns);
+
+	Script script(settings.sample_rate);
+	Module::ProcessArgs args;
+	args.sampleRate = settings.sample_rate;
+	args.sampleTime = 1.0f / settings.sample_rate;
+
+	r.seconds = timeRender([&]() {
+		for (int64_t frame = 0; frame < r.frames; frame++) {
+			clock.voltages[0] = script.clock(frame);
+			args.frame = frame;
+			module->process(args);
+			r.data[frame * 3 + 0] = cv.voltages[0];
+			r.data[frame * 3 + 1] = gate.voltages[0];
+			r.data[frame * 3 + 2] = accent.voltages[0];
+		}
+	});
+	delete module;
+	return r;
+}
+
+static std::vector<Scenario> scenarios() {
+	std::vector<Scenario> list;
+
+	list.push_back({"station_default", []() {
+		StationSettings s;
+		return renderStation(s, 2.0);
+	}});
+
+	list.push_back({"station_envmod_resonance", []() {
+		StationSettings s;
+		s.params = {{"Resonance", 1.0f}, {"Envelope modulation", 0.8f}, {"Accent amount", 1.0f}, {"VCF Decay", -1.0f}, {"Drive", 0.5f}};
+		return renderStation(s, 2.0);
+	}});
+
+	list.push_back({"station_hold_44k", []() {
+		StationSettings s;
+		s.sample_rate = 44100.0f;
+		s.params = {{"Hold", 1.0f}, {"Resonance", 0.6f}, {"Envelope modulation", 0.5f}};
+		return renderStation(s, 2.0);
+	}});
+
+	list.push_back({"station_audio_fm", []() {
+		StationSettings s;
+		s.audio_fm = true;
+		s.params = {{"FM Amount", 0.5f}, {"Resonance", 0.8f}, {"Envelope modulation", 0.5f}};
+		return renderStation(s, 2.0);
+	}});
+
+	list.push_back({"station_poly4_adaa_4x", []() {
+		StationSettings s;
+		s.channels = 4;
+		s.polyphonic = true;
+		s.oversampling = 4;
+		s.drive_mode = 1;
+		s.params = {{"Resonance", 0.9f}, {"Envelope modulation", 0.5f}, {"Drive", 0.8f}};
+		return renderStation(s, 2.0);
+	}});
+
+	// Covers gates, ties, rests, slides into and out of ties, accents and octave shifts
+	const char* notes = "C C D#E F G A B C C D E F G A B ";
+	const char* octave = "  U  D   U  D   ";
+	const char* slide_accent = "A   S A   S A  S A  S  A   S A  ";
+	const char* time = "oooo_o-ooo_oo-oo";
+
+	list.push_back({"composer_pattern", [=]() {
+		ComposerSettings s;
+		s.notes = notes;
+		s.octave = octave;
+		s.slide_accent = slide_accent;
+		s.time = time;
+		return renderComposer(s, 4.0);
+	}});
+
+	list.push_back({"composer_short_pattern_96k", [=]() {
+		ComposerSettings s;
+		s.sample_rate = 96000.0f;
+		s.header = "A 7 -5";
+		s.notes = notes;
+		s.octave = octave;
+		s.slide_accent = slide_accent;
+		s.time = time;
+		return renderComposer(s, 4.0);
+	}});
+
+	list.push_back({"composer_slow_slide", [=]() {
+		ComposerSettings s;
+		s.notes = notes;
+		s.octave = octave;
+		s.slide_accent = "S S S S S S S S S S S S S S S S ";
+		s.time = "o___o___o_o_oooo";
+		s.slide_res = 1.0f;
+		s.slide_cap = 1.0f;
+		return renderComposer(s, 4.0);
+	}});
+
+	list.push_back({"composer_chain", [=]() {
+		ComposerSettings s;
+		s.header = "A 12 +0";
+		s.header_b = "B 5 +7";
+		s.chain = "AAB";
+		s.notes = notes;
+		s.octave = octave;
+		s.slide_accent = slide_accent;
+		s.time = time;
+		return renderComposer(s, 6.0);
+	}});
+
+	return list;
+}
+
+struct GoldenHeader {
+	char magic[4];
+	uint32_t version;
+	float sample_rate;
+	uint32_t kind;
+	uint32_t columns;
+	uint32_t frames;
+};
+
+static const uint32_t GOLDEN_VERSION = 1;
+
+static std::string goldenPath(const std::string& dir, const std::string& name) {
+	return dir + "/" + name + ".bin";
+}
+
+static bool writeRender(const std::string& path, const Render& r) {
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	GoldenHeader header = {{'T', 'A', 'K', 'G'}, GOLDEN_VERSION, r.sample_rate, (uint32_t)r.kind, (uint32_t)r.columns, (uint32_t)r.frames};
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+			  && std::fwrite(r.data.data(), sizeof(float), r.data.size(), file) == r.data.size();
+	std::fclose(file);
+	return ok;
+}
+
+static bool readRender(const std::string& path, Render* r) {
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	GoldenHeader header;
+	bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+			  && std::memcmp(header.magic, "TAKG", 4) == 0
+			  && header.version == GOLDEN_VERSION;
+	if (ok) {
+		r->kind = (Render::Kind)header.kind;
+		r->sample_rate = header.sample_rate;
+		r->columns = header.columns;
+		r->frames = header.frames;
+		r->data.resize((size_t)r->frames * r->columns);
+		ok = std::fread(r->data.data(), sizeof(float), r->data.size(), file) == r->data.size();
+	}
+	std::fclose(file);
+	return ok;
+}
+
+// Frames where the column crosses the edge threshold, signed by direction
+static std::vector<int64_t> edges(const Render& r, int column) {
+	std::vector<int64_t> list;
+	bool high = false;
+	for (int64_t frame = 0; frame < r.frames; frame++) {
+		bool now = r.data[frame * r.columns + column] >= EDGE_THRESHOLD;
+		if (now != high)
+			list.push_back(now ? frame : -frame);
+		high = now;
+	}
+	return list;
+}
+
+static bool compareEdges(const Render& out, const Render& ref, int column, const char* what) {
+	std::vector<int64_t> a = edges(out, column);
+	std::vector<int64_t> b = edges(ref, column);
+	for (size_t i = 0; i < std::min(a.size(), b.size()); i++) {
+		if (a[i] != b[i]) {
+			std::printf("    %s edge %zu at frame %lld, expected %lld\n", what, i, (long long)std::abs(a[i]), (long long)std::abs(b[i]));
+			return false;
+		}
+	}
+	if (a.size() != b.size()) {
+		std::printf("    %zu %s edges, expected %zu\n", a.size(), what, b.size());
+		return false;
+	}
+	return true;
+}
+
+static bool compare(const Render& out, const Render& ref) {
+	if (out.kind != ref.kind || out.columns != ref.columns || out.frames != ref.frames || out.sample_rate != ref.sample_rate) {
+		std::printf("    render shape differs from the reference\n");
+		return false;
+	}
+
+	if (out.kind == Render::SEQUENCER) {
+		bool ok = compareEdges(out, ref, 1, "gate") && compareEdges(out, ref, 2, "accent");
+		float worst = 0.0f;
+		int64_t worst_frame = 0;
+		for (int64_t frame = 0; frame < out.frames; frame++) {
+			float cents = std::fabs(out.data[frame * 3] - ref.data[frame * 3]) * 1200.0f;
+			if (cents > worst) {
+				worst = cents;
+				worst_frame = frame;
+			}
+		}
+		std::printf("    CV error %.3f cents at frame %lld\n", worst, (long long)worst_frame);
+		return ok && worst <= CV_CENTS_BUDGET;
+	}
+
+	bool ok = true;
+	for (int c = 0; c < out.columns; c++) {
+		double error_sum = 0.0, ref_sum = 0.0;
+		float peak = 0.0f;
+		for (int64_t frame = 0; frame < out.frames; frame++) {
+			float a = out.data[frame * out.columns + c];
+			float b = ref.data[frame * ref.columns + c];
+			error_sum += (a - b) * (a - b);
+			ref_sum += b * b;
+			peak = std::max(peak, std::fabs(a - b));
+		}
+		float error_rms = std::sqrt(error_sum / out.frames);
+		float ref_rms = std::sqrt(ref_sum / out.frames);
+		float relative = error_rms / std::max(ref_rms, 1e-6f);
+		std::printf("    channel %d: RMS error %.1f dB, peak error %.4f V\n", c, 20.0f * std::log10(std::max(relative, 1e-12f)), peak);
+		ok = ok && std::isfinite(relative) && relative <= AUDIO_RMS_BUDGET && peak <= AUDIO_PEAK_BUDGET;
+	}
+	return ok;
+}
+
+static void reportTime(const std::string& name, const Render& r) {
+	double realtime = r.frames / r.sample_rate;
+	std::printf("%-28s %8.2f ms render, %7.1fx real time\n", name.c_str(), r.seconds * 1e3, realtime / r.seconds);
+}
+
+int recordGolden(const std::string& dir) {
+	int failures = 0;
+	for (auto& scenario : scenarios()) {
+		Render r = scenario.render();
+		reportTime(scenario.name, r);
+		if (!writeRender(goldenPath(dir, scenario.name), r)) {
+			std::printf("    could not write %s\n", goldenPath(dir, scenario.name).c_str());
+			failures++;
+		}
+	}
+	return failures ? 1 : 0;
+}
+
+int checkGolden(const std::string& dir) {
+	int failures = 0;
+	for (auto& scenario : scenarios()) {
+		Render r = scenario.render();
+		reportTime(scenario.name, r);
+		Render ref;
+		if (!readRender(goldenPath(dir, scenario.name), &ref)) {
+			std::printf("    missing reference %s, record it first from the unchanged tree\n", goldenPath(dir, scenario.name).c_str());
+			failures++;
+			continue;
+		}
+		if (!compare(r, ref)) {
+			std::printf("    FAILED\n");
+			failures++;
+		}
+	}
+	std::printf("%d failures\n", failures);
+	return failures ? 1 : 0;
+}
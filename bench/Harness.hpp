@@ -0,0 +1,96 @@
+#pragma once
+#include "plugin.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+// Scripted control streams: 16th notes at 130 BPM, 50% duty cycle, accent on every third step
+struct Script {
+	float sample_rate;
+	double step_length;
+
+	Script(float sample_rate) : sample_rate(sample_rate) {
+		step_length = sample_rate * 60.0 / 130.0 / 4.0;
+	}
+
+	int step(int64_t frame, int channel) const {
+		// Voices are offset so they don't all trigger on the same frame
+		return (int)((frame + channel * 97) / step_length);
+	}
+
+	float gate(int64_t frame, int channel) const {
+		double phase = (frame + channel * 97) / step_length;
+		return (phase - std::floor(phase)) < 0.5 ? 10.0f : 0.0f;
+	}
+
+	float accent(int64_t frame, int channel) const {
+		return step(frame, channel) % 3 == 0 ? 10.0f : 0.0f;
+	}
+
+	float clock(int64_t frame) const {
+		return gate(frame, 0);
+	}
+
+	// Naive saw, the benchmark doesn't care about aliasing
+	float saw(int64_t frame, int channel) const {
+		double period = sample_rate / (55.0 * (1 + channel % 4));
+		double phase = frame / period;
+		return 10.0f * (float)(phase - std::floor(phase)) - 5.0f;
+	}
+};
+
+// What the engine does with the expander messages between two frames
+inline void flipExpanderMessages(Module* module) {
+	for (Module::Expander* expander : {&module->leftExpander, &module->rightExpander}) {
+		if (expander->messageFlipRequested) {
+			std::swap(expander->producerMessage, expander->consumerMessage);
+			expander->messageFlipRequested = false;
+		}
+	}
+}
+
+// Ports and params are looked up by the name they were configured with, so the harness
+// doesn't need the module definitions
+inline int findInput(Module* module, const char* name) {
+	for (size_t i = 0; i < module->inputInfos.size(); i++) {
+		if (module->inputInfos[i]->name == name)
+			return i;
+	}
+	std::fprintf(stderr, "No input named %s\n", name);
+	std::exit(1);
+}
+
+inline int findOutput(Module* module, const char* name) {
+	for (size_t i = 0; i < module->outputInfos.size(); i++) {
+		if (module->outputInfos[i]->name == name)
+			return i;
+	}
+	std::fprintf(stderr, "No output named %s\n", name);
+	std::exit(1);
+}
+
+inline int findParam(Module* module, const char* name) {
+	for (size_t i = 0; i < module->paramQuantities.size(); i++) {
+		if (module->paramQuantities[i] && module->paramQuantities[i]->name == name)
+			return i;
+	}
+	std::fprintf(stderr, "No param named %s\n", name);
+	std::exit(1);
+}
+
+inline void setSampleRate(Module* module, float sample_rate) {
+	Module::SampleRateChangeEvent e;
+	e.sampleRate = sample_rate;
+	e.sampleTime = 1.0f / sample_rate;
+	module->onSampleRateChange(e);
+}
+
+// Golden-render regression checks, see Golden.cpp
+int recordGolden(const std::string& dir);
+int checkGolden(const std::string& dir);
+
+// Pattern chart parser fuzzing, see Fuzz.cpp
+int runFuzz(const std::string& dir, int iterations);
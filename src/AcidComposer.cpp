@@ -2,85 +2,15 @@
 // PhraseSeq16 is copyright © 2018-2021 Marc Boulé and is licensed under the terms of the GNU GPL either v3 or later
 
 #include "plugin.hpp"
-#include "header_regex.hpp"
-
-#include "chowdsp_wdf/chowdsp_wdf.h"
-
-float SEMITONE = (1.0/12.0);
-
-namespace wdft = chowdsp::wdft;
-struct RCLowpass {
-	wdft::ResistorT<double> r1 { 100.0e3 };
-	wdft::CapacitorT<double> c1 { .22e-6 };
-	
-	wdft::WDFSeriesT<double, decltype (r1), decltype (c1)> s1 { r1, c1 };
-	wdft::IdealVoltageSourceT<double, decltype (s1)> vSource { s1 };
-   
-	double lastSample;
-
-	void setRackParameters(float rMod, float cMod) {
-		float newR = 100.0e3 + 99.9e3 * rMod;
-		float newC = 220e-9 + 219.9e-9 * cMod;
-		r1.setResistanceValue(newR);
-		c1.setCapacitanceValue(newC);
-
-	}
-
-	bool prepared = false;
-	void prepare (double sampleRate) {
-		c1.prepare (sampleRate);
-		prepared = true;
-	}
-	
-	inline double processSample (double x) {
-		vSource.setVoltage (x);
-
-		vSource.incident (s1.reflected());
-		s1.incident (vSource.reflected());
-
-		lastSample = -1 * wdft::voltage<double> (c1);
-		return lastSample;
-	}
-};
-
-// PS16
-class StepAttributes {
-	unsigned short attributes;
-	
-	public:
-
-	static const unsigned short ATT_ST_GATE = 0x01;
-	static const unsigned short ATT_ST_ACCENT = 0x04;
-	static const unsigned short ATT_ST_SLIDE = 0x08;
-	static const unsigned short ATT_ST_TIED = 0x10;
-	
-	static const unsigned short ATT_ST_INIT =  ATT_ST_GATE;
-	
-	inline void clear() {attributes = 0u;}
-	inline void init() {attributes = ATT_ST_INIT;}
-	
-	inline bool getGate() {return (attributes & ATT_ST_GATE) != 0;}
-	inline bool getAccent() {return (attributes & ATT_ST_ACCENT) != 0;}
-	inline bool getSlide() {return (attributes & ATT_ST_SLIDE) != 0;}
-	inline bool getTie() {return (attributes & ATT_ST_TIED) != 0;}
-	inline unsigned short getAttribute() {return attributes;}
-
-	inline void setGate(bool gateState) {attributes &= ~ATT_ST_GATE; if (gateState) attributes |= ATT_ST_GATE;}
-	inline void setAccent(bool accentState) {attributes &= ~ATT_ST_ACCENT; if (accentState) attributes |= ATT_ST_ACCENT;}
-	inline void setSlide(bool slideState) {attributes &= ~ATT_ST_SLIDE; if (slideState) attributes |= ATT_ST_SLIDE;}
-	inline void setTie(bool tiedState) {
-		attributes &= ~ATT_ST_TIED; 
-		if (tiedState) {
-			attributes |= ATT_ST_TIED;
-			attributes &= ~(ATT_ST_GATE | ATT_ST_ACCENT | ATT_ST_SLIDE);// clear other attributes if tied
-		}
-	}
-	inline void setAttribute(unsigned short _attributes) {attributes = _attributes;}
-
-	inline void toggleGate() {attributes ^= ATT_ST_GATE;}
-	inline void toggleAccent() {attributes ^= ATT_ST_ACCENT;}
-	inline void toggleSlide() {attributes ^= ATT_ST_SLIDE;}
-};// class StepAttributes
+#include "ClockFollower.hpp"
+#include "ComposerLink.hpp"
+#include "PatternIndex.hpp"
+#include "PatternLibrary.hpp"
+#include "PatternParser.hpp"
+#include "Profiler.hpp"
+#include "RCLowpass.hpp"
+#include "TelemetryRing.hpp"
+#include "TripleBuffer.hpp"
 
 struct ComposerSequence {
 	std::string headerStr;
@@ -88,7 +18,16 @@ struct ComposerSequence {
 	std::string octaveStr;
 	std::string slideAccentStr;
 	std::string timeStr;
-	bool dirty;
+};
+
+// Sequencer state shown by the UI, published by the audio thread every TELEMETRY_DIVISION frames
+struct ComposerTelemetry {
+	int64_t frame = 0; // engine frame it was taken on
+	uint8_t steps[16] = {}; // per track
+	uint8_t patterns[16] = {};
+	uint16_t gates = 0; // track masks
+	uint16_t accents = 0;
+	uint8_t tracks = 0;
 };
 
 struct AcidComposer : Module {
@@ -102,6 +41,7 @@ struct AcidComposer : Module {
 	enum InputId {
 		RESET_INPUT,
 		CLOCK_INPUT,
+		PATTERN_INPUT,
 		INPUTS_LEN
 	};
 	enum OutputId {
@@ -116,39 +56,94 @@ struct AcidComposer : Module {
 		LIGHTS_LEN
 	};
 
-	ComposerSequence sequence;
+	enum PatternInputMode {
+		PATTERN_INPUT_CV, // 1/12V per pattern, from A at 0V
+		PATTERN_INPUT_TRIGGER, // each trigger moves on to the next pattern of the chain
+		PATTERN_INPUT_MODES_LEN
+	};
+
+	// Gate length, either copied from the clock input or a fraction of the measured step
+	static constexpr int GATE_LENGTHS_LEN = 5;
+	static constexpr float gateLengths[GATE_LENGTHS_LEN] = {0.f, 0.25f, 0.5f, 0.558f, 0.75f};
+	// Clock input pulses per 16th note step: one, 24 PPQN (DIN sync) or 48 PPQN
+	static constexpr int CLOCK_RESOLUTIONS_LEN = 3;
+	static constexpr int clockDivisions[CLOCK_RESOLUTIONS_LEN] = {1, 6, 12};
+
+	static constexpr int PATTERNS = ComposerBank::PATTERNS;
+	static constexpr int MAX_TRACKS = 16;
+	static constexpr int SLIDE_BLOCKS = MAX_TRACKS / 4;
+	static constexpr int TELEMETRY_DIVISION = 256;
+
+	enum ProfileStages {
+		PROFILE_SEQUENCER,
+		PROFILE_SLIDE,
+		PROFILE_PARSE, // UI thread, per chart compiled
+		PROFILE_STAGES_LEN
+	};
+	static const char* const PROFILE_STAGE_NAMES[PROFILE_STAGES_LEN];
 
-	RCLowpass slideFilter;
+	ComposerSequence sequences[PATTERNS];
+	int editIndex = 0; // pattern shown in the editor, played when there is no chain
+	std::string chainStr;
 
-	float currentCv;
-	bool currentAccent;
-	bool currentSlide;
+	// Tracks play side by side on the channels of the outputs, track n plays the pattern
+	// n letters after the selected one. Set through the bank, this is the count playing.
+	int tracks = 1;
+	RCLowpass<simd::float_4> slideFilters[SLIDE_BLOCKS];
+
+	float currentCv[MAX_TRACKS] = {};
+	bool currentAccent[MAX_TRACKS] = {};
+	bool currentSlide[MAX_TRACKS] = {};
+	uint16_t gates = 0; // tracks whose gate is high
 
 	// PS16
-	dsp::SchmittTrigger clockTrigger;
+	ClockFollower clockFollower;
 	dsp::SchmittTrigger runningTrigger;
 	dsp::SchmittTrigger resetTrigger;
 	bool running;
-	int stepIndexRun;
-	float notes[16][16];
-	float sharpflats[16][16];
-	float octaves[16][16];
-	float transposes[16];
-	char letters[16];
-	uint8_t lengths[16];
-	StepAttributes attributes[16][16];
+	int stepIndexRun[MAX_TRACKS] = {};
+	// Compiled on the UI thread, picked up by the audio thread at step boundaries
+	TripleBuffer<ComposerBank> banks;
+	bool stepBoundary = true;
+	// Patterns only change at the end of the playing one, the chain moves on with the first track
+	int patternIndex[MAX_TRACKS] = {};
+	bool patternBoundary[MAX_TRACKS] = {};
+	int selectedPattern = 0;
+	int chainIndex = 0;
+	bool chainAdvance = false;
+	dsp::SchmittTrigger patternTrigger;
+	TelemetryRing<ComposerTelemetry> telemetry;
+	dsp::ClockDivider telemetryDivider;
+	Profile<PROFILE_STAGES_LEN> profile; // empty unless built with TAK_PROFILE
+	// UI thread: the last compiled patterns and the charts they came from, so edits only recompile their steps
+	ComposerPattern editedPatterns[PATTERNS];
+	ComposerSequence compiledSequences[PATTERNS];
+	ComposerBank editedBank;
+	// Pattern library browsed from the context menu, loaded patterns replace the edited one
+	PatternLibrary library;
+	PatternIndex libraryIndex; // built on the first search
+	bool reloadEditor = false;
 	static constexpr float clockIgnoreOnResetDuration = 0.001f;// disable clock on powerup and reset for 1 ms (so that the first step plays)
 	long clockIgnoreOnReset;
 	float resetLight;
 
 	// json
 	bool resetOnRun;
+	int patternInputMode = PATTERN_INPUT_CV;
+	int gateLength = 0;
+	int clockResolution = 0;
+
+	// Double buffer for the leftExpander messages, written by the AcidStation on the left
+	ComposerLinkMessage linkMessages[2];
 
 	AcidComposer() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		leftExpander.producerMessage = &linkMessages[0];
+		leftExpander.consumerMessage = &linkMessages[1];
 		// PS16
 		configInput(CLOCK_INPUT, "Clock");
 		configInput(RESET_INPUT, "Reset");
+		configInput(PATTERN_INPUT, "Pattern select");
 
 		configOutput(CV_OUTPUT, "CV");
 		configOutput(GATE_OUTPUT, "Gate");
@@ -160,14 +155,21 @@ struct AcidComposer : Module {
 		configParam(CAP_PARAM, -1.f, 1.f, 0.f, "Slide capacitor");
 
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
+		telemetryDivider.setDivision(TELEMETRY_DIVISION);
+		for (auto& slideFilter : slideFilters) {
+			slideFilter.prepare(APP->engine->getSampleRate());
+		}
 
-		sequence.headerStr = std::string("A 16 +0");
-		sequence.notesStr = std::string(64, ' ');
-		sequence.octaveStr = std::string(64, ' ');
-		sequence.slideAccentStr = std::string(64, ' ');
-		sequence.timeStr = std::string(64, ' ');
-		parseSeq();
-		sequence.dirty = false;
+		for (int i = 0; i < PATTERNS; i++) {
+			sequences[i].headerStr = std::string(1, 'A' + i) + " 16 +0";
+			sequences[i].notesStr = std::string(64, ' ');
+			sequences[i].octaveStr = std::string(64, ' ');
+			sequences[i].slideAccentStr = std::string(64, ' ');
+			sequences[i].timeStr = std::string(64, ' ');
+			compileSequence(i);
+		}
+		publishBank();
+		banks.update();
 
 		resetOnRun = true;
 
@@ -176,178 +178,147 @@ struct AcidComposer : Module {
 
 	void initRun() { // run button activated or run edge in run input jack
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
-		stepIndexRun = 0;
-	}
-
-	float noteToCv(unsigned char ch) {
-		float note;
-		switch (ch) {
-			case 'c':
-			case 'C':
-				note = 0.0;
-				break;
-			case 'd':
-			case 'D':
-				note = 2.0 / 12.0;
-				break;
-			case 'e':
-			case 'E':
-				note = 4.0 / 12.0;
-				break;
-			case 'f':
-			case 'F':
-				note = 5.0 / 12.0;
-				break;
-			case 'g':
-			case 'G':
-				note = 7.0 / 12.0;
-				break;
-			case 'a':
-			case 'A':
-				note = 9.0 / 12.0;
-				break;
-			case 'b':
-			case 'B':
-				note = 11.0 / 12.0;
-				break;
-			default:
-				note = 0.0;
-				break;
-		}
-		return note;
-	}
-
-	void clearSeq() {
-		for (int i = 0; i < 16; ++i)
-		{
-			notes[0][i] = 0.0;
-			octaves[0][i] = 0.0;
-			attributes[0][i].clear();
-		}
-	}
-
-	int parseSeq() {
-		std::string letter;
-		int length;
-		int transpose;
-
-		clearSeq();
-
-		std::cmatch m;
-
-		DEBUG("Parsing Header: %s Len:%zu", sequence.headerStr.c_str(), sequence.headerStr.size());
-		// Header
-		if (header_search(sequence.headerStr.c_str(), &m)) {
-			if (m.size() > 0) {
-				letter = m.str(1).substr(0,1);
-				length = std::stoi(m.str(2));
-				transpose = (m.str(3).size() ? std::stoi(m.str(3)) : 0);
-			} else return -2; // Invalid header
-		} else return -2; // Invalid header
-
-		DEBUG("Parsing Notes: %s Len:%zu", sequence.notesStr.c_str(), sequence.notesStr.size());
-		int step = 0;
-		std::string line = sequence.notesStr;
-		for (; step < length && step < (int)line.size(); ++step) {
-			if (line.at(step * 2) != ' ') {
-				float cv = noteToCv(line.at(step * 2));
-				DEBUG("%d %f %c", step, cv, step);
-				notes[0][step] = cv;
-				if (line.at((step * 2) + 1) == '#') { notes[0][step] += SEMITONE; }
-				if (line.at((step * 2) + 1) == 'b') { notes[0][step] -= SEMITONE; }
-			} else {
-				notes[0][step] = 0.0;
-			}
+		for (int t = 0; t < MAX_TRACKS; t++) {
+			stepIndexRun[t] = 0;
+			patternBoundary[t] = true;
 		}
+		stepBoundary = true;
+		chainIndex = 0;
+		chainAdvance = false;
+	}
 
-		DEBUG("Parsing Octaves (Up/Down): %s Len:%zu", sequence.octaveStr.c_str(), sequence.octaveStr.size());
-		line = sequence.octaveStr;
-		for (step = 0; step < length && step < (int)line.size(); ++step)
-		{	
-			if (line.at(step) == 'U' || line.at(step) == 'u' ) { octaves[0][step] = 1.0; }
-			else if (line.at(step) == 'D' || line.at(step) == 'd' ) { octaves[0][step] = -1.0; }
-			else { octaves[0][step] = 0.0; }
-		}
-
-		DEBUG("Parsing Slide/Accent: %s Len:%zu", sequence.slideAccentStr.c_str(), sequence.slideAccentStr.size());
-		line = sequence.slideAccentStr;
-		for (step = 0; step < length && step < (int)line.size(); ++step) {
-			if (line.at(step * 2) != ' ') {
-				if (line.at((step * 2) + 1) == 'S' || line.at((step * 2) + 1) == 's' ||
-					line.at(step * 2) == 'S' || line.at(step * 2) == 's') {
-					attributes[0][step].setSlide(true);
-					// DEBUG("Slide %d %d", step, attributes[0][step].getSlide());
-				}
-				if (line.at((step * 2) + 1) == 'A' || line.at((step * 2) + 1) == 'a' ||
-					line.at(step * 2) == 'A' || line.at(step * 2) == 'a') {
-					attributes[0][step].setAccent(true);
-					// DEBUG("Accent %d %d", step, attributes[0][step].getAccent());
-				}
-			}
+	// Compiles the chart of a pattern, only reparsing the steps that changed since the last time
+	void compileSequence(int index) {
+		const ComposerSequence& before = compiledSequences[index];
+		const ComposerSequence& after = sequences[index];
+		ChartLine beforeLines[] = {before.headerStr, before.notesStr, before.octaveStr, before.slideAccentStr, before.timeStr};
+		ChartLine afterLines[] = {after.headerStr, after.notesStr, after.octaveStr, after.slideAccentStr, after.timeStr};
+		uint32_t steps = changedSteps(beforeLines, afterLines);
+		ProfileClock clock;
+		PatternParseResult result = parsePattern(afterLines[0], afterLines[1], afterLines[2], afterLines[3], afterLines[4],
+			&editedPatterns[index], steps);
+		profile.add(PROFILE_PARSE, clock.lap(), 1);
+		if (result.error != PatternParseResult::OK) {
+			DEBUG("Parse error in pattern %c: %s at line %d, column %d", 'A' + index, result.message(), result.line, result.column);
 		}
-		
-		DEBUG("Parsing Time: %s Len:%zu", sequence.timeStr.c_str(), sequence.timeStr.size());
-		line = sequence.timeStr;
-		for (step = 0; step < length && step < (int)line.size(); ++step)
-		{	
-			if (line.at(step) == 'O' || line.at(step) == 'o' ) { attributes[0][step].setGate(true); }
-			else if (line.at(step) == '_') { attributes[0][step].setTie(true); }
-			else if (line.at(step) == ' ' || line.at(step) == '-' ) { attributes[0][step].clear(); } // Rest, redundant but just as a security
-			else {
-				attributes[0][step].clear();
-				return -4; // wrong time value
-			}
+		compiledSequences[index] = after;
+		editedBank.store(index, editedPatterns[index]);
+	}
+
+	// Chain of pattern letters, anything else is ignored
+	void compileChain() {
+		editedBank.chain_length = 0;
+		for (char c : chainStr) {
+			if (c >= 'a' && c <= 'z')
+				c += 'A' - 'a';
+			if (c >= 'A' && c < 'A' + PATTERNS && editedBank.chain_length < ComposerBank::MAX_CHAIN)
+				editedBank.chain[editedBank.chain_length++] = c - 'A';
 		}
-		DEBUG("Letter: %s", letter.c_str());
-		letters[0] = letter.at(0);
-		DEBUG("Length: %d", length);
-		lengths[0] = length;
-		DEBUG("Transpose: %d", transpose);
-		transposes[0] = transpose * SEMITONE;
-		for (int i = 0; i < length; ++i)
-		{	
-			unsigned char ud;
-			if (octaves[0][i] == 1.0) ud = 'u';
-			else if (octaves[0][i] == -1.0) ud = 'd';
-			else ud = ' ';
-			const char *time;
-			if (attributes[0][i].getGate()) time = "Gate";
-			else if (attributes[0][i].getTie()) time = "Tie";
-			else if (attributes[0][i].getAttribute() == 0u) time = "Rest";
-			else time = "";			
-			DEBUG("%d|Sha/Fla:%0.2f|Cv:%0.2f(%0.2fHz|U/D:%c|Acc/Sli:%c%c|Time:%s)"
-				, i, sharpflats[0][i], notes[0][i], dsp::FREQ_C4 * pow(2,notes[0][i]), ud,
-				(attributes[0][i].getAccent() ? 'A' : ' '), (attributes[0][i].getSlide() ? 'S' : ' '), time);
-		}
-		return 0;
 	}
 
-	float oldResParam;
-	float oldCapParam;
-	void process(const ProcessArgs& args) override {
+	// Hands the compiled bank to the audio thread.
+	// Only called from the UI thread (or while the engine is locked, from dataFromJson).
+	void publishBank() {
+		banks.writeBuffer() = editedBank;
+		banks.publish();
+	}
+
+	void publishSequence(int index) {
+		compileSequence(index);
+		publishBank();
+	}
 
-		if (!slideFilter.prepared) {
-			slideFilter.prepare(args.sampleRate);
+	void publishChain() {
+		compileChain();
+		publishBank();
+	}
+
+	void publishTracks(int count) {
+		editedBank.tracks = count;
+		publishBank();
+	}
+
+	// Library patterns that sound closest to the edited one
+	std::vector<PatternIndex::Match> findSimilarPatterns(int count) {
+		libraryIndex.build(library);
+		const ComposerSequence& sequence = sequences[editIndex];
+		ChartLine chart[] = {sequence.headerStr, sequence.notesStr, sequence.octaveStr, sequence.slideAccentStr, sequence.timeStr};
+		PatternRecord record = encodePattern(chart, editedPatterns[editIndex], "");
+		return libraryIndex.findSimilar(PatternSignature::of(record), count);
+	}
+
+	// Replaces the edited pattern with one from the library, keeping the letter of its slot
+	void loadLibraryPattern(int index) {
+		if (index >= library.count)
+			return;
+		std::string chart[PatternParseResult::LINES_LEN];
+		decodePattern(library.record(index), 'A' + editIndex, chart);
+		ComposerSequence& sequence = sequences[editIndex];
+		sequence.headerStr = chart[PatternParseResult::HEADER];
+		sequence.notesStr = chart[PatternParseResult::NOTES];
+		sequence.octaveStr = chart[PatternParseResult::OCTAVE];
+		sequence.slideAccentStr = chart[PatternParseResult::SLIDE_ACCENT];
+		sequence.timeStr = chart[PatternParseResult::TIME];
+		publishSequence(editIndex);
+		reloadEditor = true;
+	}
+
+	// The pattern to play after a pattern boundary
+	int selectPattern(const ComposerBank& bank, bool advance) {
+		bool connected = inputs[PATTERN_INPUT].isConnected();
+		if (connected && patternInputMode == PATTERN_INPUT_CV) {
+			return math::clamp((int)std::round(inputs[PATTERN_INPUT].getVoltage() * 12.f), 0, PATTERNS - 1);
+		}
+		if (bank.chain_length == 0) {
+			// Triggers without a chain step through the whole bank
+			return connected ? chainIndex % PATTERNS : editIndex;
 		}
+		// Song mode, unless triggers move through the chain
+		if (advance && !connected) {
+			chainIndex++;
+		}
+		chainIndex %= bank.chain_length;
+		return bank.chain[chainIndex];
+	}
 
-		if (sequence.dirty) {
-			DEBUG("Header: %s", sequence.headerStr.c_str());
-			DEBUG("Notes: %s", sequence.notesStr.c_str());
-			DEBUG("Octaves: %s", sequence.octaveStr.c_str());
-			DEBUG("Slide/Accent: %s", sequence.slideAccentStr.c_str());
-			DEBUG("Time: %s", sequence.timeStr.c_str());
-			int parseErr = parseSeq();
-			if (parseErr) {
-				DEBUG("Parse error: %d", parseErr);
-			}
-			sequence.dirty = false;
+	// One cache line for the UI, see SequenceDisplay
+	void publishTelemetry(int64_t frame) {
+		ComposerTelemetry record;
+		record.frame = frame;
+		record.tracks = tracks;
+		record.gates = gates;
+		for (int t = 0; t < tracks; t++) {
+			record.steps[t] = stepIndexRun[t];
+			record.patterns[t] = patternIndex[t];
+			record.accents |= currentAccent[t] << t;
 		}
+		telemetry.publish(record);
+	}
+
+	// The AcidStation on the left runs the sequencer instead, see ComposerLink.hpp
+	bool isPlayedByStation() {
+		const ComposerLinkMessage* link = static_cast<const ComposerLinkMessage*>(leftExpander.consumerMessage);
+		return link->station && link->station == leftExpander.module;
+	}
 
+	void process(const ProcessArgs& args) override {
+		if (!isPlayedByStation())
+			processSequencer(args);
+	}
+
+	float oldResParam;
+	float oldCapParam;
+	void processSequencer(const ProcessArgs& args) {
+		ProfileClock profileClock;
+		uint64_t sequencerTicks = 0;
 		// Run button
 		if (runningTrigger.process(params[RUN_PARAM].getValue())) {
 			running = !running;
+			stepBoundary = true;
 			if (running) {
-				stepIndexRun = 0;
+				for (int t = 0; t < MAX_TRACKS; t++) {
+					stepIndexRun[t] = 0;
+				}
 				clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate());
 				if (resetOnRun) {
 					initRun();
@@ -357,79 +328,137 @@ struct AcidComposer : Module {
 
 		//********** Clock and reset **********
 		
-		// Clock
-		if (running && clockIgnoreOnReset == 0l) {
-			if (clockTrigger.process(inputs[CLOCK_INPUT].getVoltage())) {
-				stepIndexRun++;
-				if (stepIndexRun >= 16) {
-					stepIndexRun = 0;
+		// Clock, always followed so the period is known when the sequencer starts
+		clockFollower.division = clockDivisions[clockResolution];
+		float clockVoltage = inputs[CLOCK_INPUT].getVoltage();
+		bool clockStep = clockFollower.process(clockVoltage);
+		if (clockIgnoreOnReset > 0l) {
+			// A pulse coinciding with a reset starts the first step instead of skipping it
+			if (clockFollower.pulsed) {
+				clockFollower.restart();
+			}
+			clockStep = false;
+		}
+		if (running) {
+			if (clockStep) {
+				const ComposerBank& bank = banks.read();
+				for (int t = 0; t < tracks; t++) {
+					stepIndexRun[t]++;
+					if (stepIndexRun[t] >= bank.lengths[patternIndex[t]]) {
+						stepIndexRun[t] = 0;
+						patternBoundary[t] = true;
+					}
 				}
-				// DEBUG("%d %d %f", stepIndexRun + 1, attributes[0][stepIndexRun].getGate(), notes[0][stepIndexRun]);
+				chainAdvance = patternBoundary[0];
+				stepBoundary = true;
 			}
 		}
+
+		// Pattern triggers. Unpatched inputs are left alone, their triggers are reset so the
+		// first pulse after patching one counts.
+		if (patternInputMode == PATTERN_INPUT_TRIGGER && inputs[PATTERN_INPUT].isConnected()) {
+			if (patternTrigger.process(inputs[PATTERN_INPUT].getVoltage())) {
+				int chainLength = banks.read().chain_length;
+				chainIndex = (chainIndex + 1) % (chainLength ? chainLength : PATTERNS);
+			}
+		} else {
+			patternTrigger.state = false;
+		}
     
 		// Reset
-		if (resetTrigger.process(params[RESET_PARAM].getValue() + inputs[RESET_INPUT].getVoltage())) {
+		float reset = params[RESET_PARAM].getValue();
+		if (inputs[RESET_INPUT].isConnected()) {
+			reset += inputs[RESET_INPUT].getVoltage();
+		}
+		if (resetTrigger.process(reset)) {
 			initRun();
 			resetLight = 1.0f;
-			clockTrigger.reset();
+			clockFollower.restart();
 		}
 
 		if (params[RES_PARAM].getValue() != oldResParam || params[CAP_PARAM].getValue() != oldCapParam) {
 			oldResParam = params[RES_PARAM].getValue();
 			oldCapParam = params[CAP_PARAM].getValue();
-			slideFilter.setRackParameters(oldResParam, oldCapParam);
+			for (auto& slideFilter : slideFilters) {
+				slideFilter.setRackParameters(oldResParam, oldCapParam);
+			}
 		}
-		
-		// gate on duty cycle = 49.96% - 55.8% <- assume 50% and calculate based on received gate ON time?
-		if (running) {
-			// latch cv, accent and slide to gate
-			if (attributes[0][stepIndexRun].getGate()) currentCv = notes[0][stepIndexRun] + octaves[0][stepIndexRun] + transposes[0];
-			if (attributes[0][stepIndexRun].getGate()) currentAccent = attributes[0][stepIndexRun].getAccent();
-			if (attributes[0][stepIndexRun].getGate()) currentSlide = attributes[0][stepIndexRun].getSlide();
-
-			// check is upcoming step is tied or first step if current step is last of pattern
-			bool previousIsGate = attributes[0][(stepIndexRun - 1 < 0 ? 15 : stepIndexRun - 1)].getGate();
-
-			bool nextIsTie = attributes[0][(stepIndexRun + 1 >= 15 ? 0 : stepIndexRun + 1)].getTie();
-			bool previousIsTie = attributes[0][(stepIndexRun - 1 < 0 ? 15 : stepIndexRun - 1)].getTie();
 
-			bool nextIsSlide = attributes[0][(stepIndexRun + 1 >= 16 ? 0 : stepIndexRun + 1)].getSlide();
-			bool previousIsSlide = attributes[0][(stepIndexRun - 1 < 0 ? 15 : stepIndexRun - 1)].getSlide();
+		// Edits only take effect between steps, never in the middle of one
+		if (stepBoundary || !running) {
+			banks.update();
+			stepBoundary = false;
+		}
+		const ComposerBank& bank = banks.read();
+		// Tracks added while running start on the step of the first one
+		for (int t = tracks; t < bank.tracks; t++) {
+			stepIndexRun[t] = stepIndexRun[0];
+			patternBoundary[t] = true;
+		}
+		tracks = bank.tracks;
+		if (patternBoundary[0]) {
+			selectedPattern = selectPattern(bank, chainAdvance);
+			chainAdvance = false;
+		}
+		for (int t = 0; t < tracks; t++) {
+			if (patternBoundary[t]) {
+				patternIndex[t] = (selectedPattern + t) % PATTERNS;
+				patternBoundary[t] = false;
+			}
+			// The pattern may have been shortened by an edit
+			if (stepIndexRun[t] >= bank.lengths[patternIndex[t]]) {
+				stepIndexRun[t] = 0;
+			}
+		}
 
-			bool isTie = attributes[0][stepIndexRun].getTie();
-			bool isGate = attributes[0][stepIndexRun].getGate();
-			bool isSlide = attributes[0][stepIndexRun].getSlide();
+		outputs[CV_OUTPUT].setChannels(tracks);
+		outputs[GATE_OUTPUT].setChannels(tracks);
+		outputs[ACCENT_OUTPUT].setChannels(tracks);
 
-			bool clock = inputs[CLOCK_INPUT].getVoltage() > 0.1;
+		if (running) {
+			// High resolution clocks are never copied, their pulses are much shorter than a step
+			float duty = gateLengths[gateLength];
+			if (duty == 0.f && clockFollower.division > 1) {
+				duty = 0.5f;
+			}
+			bool clock = (duty > 0.f && clockFollower.hasPeriod()) ? clockFollower.gate(duty) : clockVoltage > 0.1;
+			gates = 0;
+			for (int t = 0; t < tracks; t++) {
+				uint8_t step = bank.steps[patternIndex[t]][stepIndexRun[t]];
+				if (step & ComposerBank::LATCH) {
+					currentCv[t] = bank.cv[patternIndex[t]][stepIndexRun[t]];
+					currentAccent[t] = step & ComposerBank::ACCENT;
+					currentSlide[t] = step & ComposerBank::SLIDE;
+				}
 
-			bool gate = false;
-			// copy clock : normal gate, no upcoming slide or tie
-			// or: end of a tie
-			if ((isGate && (!nextIsTie || !nextIsSlide)) || (isTie && previousIsTie && !nextIsTie)) {
-				gate = clock;
+				uint8_t gateMode = step & ComposerBank::GATE_MASK;
+				bool gate = gateMode == ComposerStep::GATE_HIGH || (gateMode == ComposerStep::GATE_FOLLOW && clock);
+				gate = gate && (clockIgnoreOnReset == 0);
+				gates |= gate << t;
+				outputs[GATE_OUTPUT].setVoltage(gate ? 10.f : 0.f, t);// gate retriggering on reset
+				outputs[ACCENT_OUTPUT].setVoltage(currentAccent[t] ? 10.f : 0.f, t);
 			}
-			// stay high: gate with upcoming slide or tie
-			// or: during a long tie or a long slide
-			if ((isGate && (nextIsTie || nextIsSlide)) || (isTie && previousIsTie && nextIsTie) || (isSlide && previousIsSlide && nextIsSlide)) {
-				gate = true;
+
+			// Four tracks per slide filter
+			sequencerTicks += profileClock.lap();
+			for (int b = 0; b * 4 < tracks; b++) {
+				int first = b * 4;
+				simd::float_4 slid = slideFilters[b].processSample(simd::float_4::load(&currentCv[first]));
+				for (int t = first; t < std::min(tracks, first + 4); t++) {
+					outputs[CV_OUTPUT].setVoltage(currentSlide[t] ? slid[t - first] : currentCv[t], t);
+				}
 			}
-			if (isTie && previousIsGate) {
-				// during the first tie after a gate, copy clock if it's just a 2 steps tie, or stay high if more tie upcoming
-				gate = (nextIsTie || nextIsSlide) ? true : clock;
+			profile.add(PROFILE_SLIDE, profileClock.lap(), tracks);
+		} else {
+			gates = 0;
+			for (int t = 0; t < tracks; t++) {
+				outputs[CV_OUTPUT].setVoltage(0.f, t);
+				outputs[GATE_OUTPUT].setVoltage(0.f, t);
 			}
+		}
 
-			bool accent = currentAccent;
-			slideFilter.processSample(currentCv);
-			float cv = currentSlide ? slideFilter.lastSample : currentCv;
-
-			// Outputs
-			outputs[CV_OUTPUT].setVoltage( cv );
-			outputs[GATE_OUTPUT].setVoltage( (gate && (clockIgnoreOnReset == 0)) ? 10.f : 0.f );// gate retriggering on reset
-			outputs[ACCENT_OUTPUT].setVoltage(accent ? 10.f : 0.f);
-		} else {
-			outputs[CV_OUTPUT].setVoltage(0.f);
-			outputs[GATE_OUTPUT].setVoltage(0.f);
+		if (telemetryDivider.process()) {
+			publishTelemetry(args.frame);
 		}
 
 		// Run light
@@ -440,21 +469,71 @@ struct AcidComposer : Module {
 		if (clockIgnoreOnReset > 0l)
 			clockIgnoreOnReset--;
 
+		profile.add(PROFILE_SEQUENCER, sequencerTicks + profileClock.lap(), tracks);
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		for (auto& slideFilter : slideFilters) {
+			slideFilter.prepare(e.sampleRate);
+		}
 	}
 
 	void onReset() override {
 		clockIgnoreOnReset = (long) (clockIgnoreOnResetDuration * APP->engine->getSampleRate()); // useful when Rack starts
 	}
 
+	static json_t* sequenceToJson(const ComposerSequence& sequence) {
+		json_t* sequenceJ = json_object();
+		json_object_set_new(sequenceJ, "header", json_stringn(sequence.headerStr.c_str(), sequence.headerStr.size()));
+		json_object_set_new(sequenceJ, "notes", json_stringn(sequence.notesStr.c_str(), sequence.notesStr.size()));
+		json_object_set_new(sequenceJ, "octave", json_stringn(sequence.octaveStr.c_str(), sequence.octaveStr.size()));
+		json_object_set_new(sequenceJ, "slideAccent", json_stringn(sequence.slideAccentStr.c_str(), sequence.slideAccentStr.size()));
+		json_object_set_new(sequenceJ, "time", json_stringn(sequence.timeStr.c_str(), sequence.timeStr.size()));
+		return sequenceJ;
+	}
+
+	// Returns true if any line was found
+	static bool sequenceFromJson(json_t* sequenceJ, ComposerSequence* sequence) {
+		json_t* headerJ = json_object_get(sequenceJ, "header");
+		if (headerJ)
+			sequence->headerStr = json_string_value(headerJ);
+
+		json_t* notesJ = json_object_get(sequenceJ, "notes");
+		if (notesJ)
+			sequence->notesStr = json_string_value(notesJ);
+
+		json_t* octaveJ = json_object_get(sequenceJ, "octave");
+		if (octaveJ)
+			sequence->octaveStr = json_string_value(octaveJ);
+
+		json_t* slideAccentJ = json_object_get(sequenceJ, "slideAccent");
+		if (slideAccentJ)
+			sequence->slideAccentStr = json_string_value(slideAccentJ);
+
+		json_t* timeJ = json_object_get(sequenceJ, "time");
+		if (timeJ)
+			sequence->timeStr = json_string_value(timeJ);
+
+		return headerJ || notesJ || octaveJ || slideAccentJ || timeJ;
+	}
+
 	json_t* dataToJson() override {
 		json_t* rootJ = json_object();
 
-		// sequence
-		json_object_set_new(rootJ, "header", json_stringn(sequence.headerStr.c_str(), sequence.headerStr.size()));
-		json_object_set_new(rootJ, "notes", json_stringn(sequence.notesStr.c_str(), sequence.notesStr.size()));
-		json_object_set_new(rootJ, "octave", json_stringn(sequence.octaveStr.c_str(), sequence.octaveStr.size()));
-		json_object_set_new(rootJ, "slideAccent", json_stringn(sequence.slideAccentStr.c_str(), sequence.slideAccentStr.size()));
-		json_object_set_new(rootJ, "time", json_stringn(sequence.timeStr.c_str(), sequence.timeStr.size()));
+		// patterns
+		json_t* patternsJ = json_array();
+		for (int i = 0; i < PATTERNS; i++) {
+			json_array_append_new(patternsJ, sequenceToJson(sequences[i]));
+		}
+		json_object_set_new(rootJ, "patterns", patternsJ);
+		json_object_set_new(rootJ, "chain", json_stringn(chainStr.c_str(), chainStr.size()));
+		json_object_set_new(rootJ, "editPattern", json_integer(editIndex));
+		if (library.isOpen())
+			json_object_set_new(rootJ, "library", json_string(library.path.c_str()));
+		json_object_set_new(rootJ, "patternInputMode", json_integer(patternInputMode));
+		json_object_set_new(rootJ, "tracks", json_integer(editedBank.tracks));
+		json_object_set_new(rootJ, "gateLength", json_integer(gateLength));
+		json_object_set_new(rootJ, "clockResolution", json_integer(clockResolution));
 
 		// resetOnRun
 		json_object_set_new(rootJ, "resetOnRun", json_boolean(resetOnRun));
@@ -466,30 +545,52 @@ struct AcidComposer : Module {
 
 	void dataFromJson(json_t* rootJ) override {
 
-		json_t* headerJ = json_object_get(rootJ, "header");
-		if (headerJ)
-			sequence.headerStr = json_string_value(headerJ);
-
-		json_t* notesJ = json_object_get(rootJ, "notes");
-		if (notesJ)
-			sequence.notesStr = json_string_value(notesJ);
+		json_t* patternsJ = json_object_get(rootJ, "patterns");
+		if (patternsJ) {
+			size_t i;
+			json_t* sequenceJ;
+			json_array_foreach(patternsJ, i, sequenceJ) {
+				if ((int)i < PATTERNS && sequenceFromJson(sequenceJ, &sequences[i]))
+					compileSequence(i);
+			}
+		}
+		// Before the bank, a single pattern was saved at the root
+		else if (sequenceFromJson(rootJ, &sequences[0])) {
+			compileSequence(0);
+		}
 
-		json_t* octaveJ = json_object_get(rootJ, "octave");
-		if (octaveJ)
-			sequence.octaveStr = json_string_value(octaveJ);
+		json_t* chainJ = json_object_get(rootJ, "chain");
+		if (chainJ) {
+			chainStr = json_string_value(chainJ);
+			compileChain();
+		}
 
-		json_t* slideAccentJ = json_object_get(rootJ, "slideAccent");
-		if (slideAccentJ)
-			sequence.slideAccentStr = json_string_value(slideAccentJ);
+		json_t* tracksJ = json_object_get(rootJ, "tracks");
+		if (tracksJ)
+			editedBank.tracks = math::clamp((int)json_integer_value(tracksJ), 1, MAX_TRACKS);
+		publishBank();
 
-		json_t* timeJ = json_object_get(rootJ, "time");
-		if (timeJ)
-			sequence.timeStr = json_string_value(timeJ);
+		json_t* editPatternJ = json_object_get(rootJ, "editPattern");
+		if (editPatternJ)
+			editIndex = math::clamp((int)json_integer_value(editPatternJ), 0, PATTERNS - 1);
 
-		if (headerJ || notesJ || octaveJ || slideAccentJ || timeJ) {
-			sequence.dirty = true;
+		json_t* libraryJ = json_object_get(rootJ, "library");
+		if (libraryJ && !library.open(json_string_value(libraryJ))) {
+			WARN("Can't open pattern library %s", json_string_value(libraryJ));
 		}
 
+		json_t* patternInputModeJ = json_object_get(rootJ, "patternInputMode");
+		if (patternInputModeJ)
+			patternInputMode = math::clamp((int)json_integer_value(patternInputModeJ), 0, PATTERN_INPUT_MODES_LEN - 1);
+
+		json_t* gateLengthJ = json_object_get(rootJ, "gateLength");
+		if (gateLengthJ)
+			gateLength = math::clamp((int)json_integer_value(gateLengthJ), 0, GATE_LENGTHS_LEN - 1);
+
+		json_t* clockResolutionJ = json_object_get(rootJ, "clockResolution");
+		if (clockResolutionJ)
+			clockResolution = math::clamp((int)json_integer_value(clockResolutionJ), 0, CLOCK_RESOLUTIONS_LEN - 1);
+
 		// resetOnRun
 		json_t *resetOnRunJ = json_object_get(rootJ, "resetOnRun");
 		if (resetOnRunJ)
@@ -504,6 +605,20 @@ struct AcidComposer : Module {
 	}
 };
 
+constexpr float AcidComposer::gateLengths[];
+constexpr int AcidComposer::clockDivisions[];
+
+const char* const AcidComposer::PROFILE_STAGE_NAMES[PROFILE_STAGES_LEN] = {"Sequencer", "Slide", "Chart parsing"};
+
+int playComposer(Module* composer, const Module::ProcessArgs& args, float* cv, float* gate, float* accent) {
+	AcidComposer* module = static_cast<AcidComposer*>(composer);
+	module->processSequencer(args);
+	module->outputs[AcidComposer::CV_OUTPUT].readVoltages(cv);
+	module->outputs[AcidComposer::GATE_OUTPUT].readVoltages(gate);
+	module->outputs[AcidComposer::ACCENT_OUTPUT].readVoltages(accent);
+	return module->tracks;
+}
+
 struct ComposerTextField : LedDisplayTextField {
 
 	AcidComposer* module;
@@ -513,16 +628,27 @@ struct ComposerTextField : LedDisplayTextField {
 	int bgSteps = 1;
 	float dxScale = 1.0;
 	float caretOffset = 0.0;
-	float dx;
-	float lh;
+	float dx = 0.0;
+	float lh = 0.0;
+	float desc = 0.0;
 	float fontSize = 12;
 	float textRadius = BND_TEXT_RADIUS * 0.5;
 	float padDown = BND_TEXT_PAD_DOWN * 1.8;
 	std::string allowedCharacters = "";
 
-	bool initSizes = false;
+	// Glyph metrics are measured once per font and size
+	int metricsFont = -1;
+	float metricsSize = 0.0;
 	bool dirty = true;
 
+	// Grid, text and caret are drawn into this, again only when what they show changes
+	FramebufferWidget* textLayer;
+	Widget* textContent;
+	std::string drawnText;
+	int drawnCursor = -1;
+	int drawnSelection = -1;
+	bool drawnFocused = false;
+
 	bool noHighlight = false;
 
 	// Modified from blendish and nanoVG
@@ -569,12 +695,10 @@ struct ComposerTextField : LedDisplayTextField {
 
 		if (cend >= cbegin) {
 			int c0r,c1r,c1n,c0n = 0;
-			float desc;
 			float c0x,c0y,c1x,c1y;
 			static NVGtextRow rows[BND_MAX_ROWS];
 			int nrows = nvgTextBreakLines(
 				ctx, label, label+cend+1, w, rows, BND_MAX_ROWS);
-			nvgTextMetrics(ctx, NULL, &desc, &lh);
 
 			mybndCaretPosition(ctx, x, y, desc, lh, label+cbegin,
 				rows, nrows, &c0r, &c0x, &c0y, &c0n);
@@ -601,26 +725,61 @@ struct ComposerTextField : LedDisplayTextField {
 			nvgFill(ctx);
 		}
 
+		// One glyph per step column, spaced by dxScale
 		nvgBeginPath(ctx);
 		nvgFillColor(ctx, color);
-		for (int i = 0; i < (int)strlen(label); ++i)
+		int length = strlen(label);
+		for (int i = 0; i < length; ++i)
 		{
-			nvgTextBox(ctx,x + dx * dxScale * i,y,w,label + i, label + i + 1);
+			nvgText(ctx, x + dx * dxScale * i, y, label + i, label + i + 1);
 		}
 	}
 
+	// The framebuffer holds the glowing text, so it is drawn on the light layer only
+	struct TextLayer : FramebufferWidget {
+		void draw(const DrawArgs& args) override {}
+
+		void drawLayer(const DrawArgs& args, int layer) override {
+			if (layer == 1)
+				FramebufferWidget::draw(args);
+		}
+	};
+
+	struct TextContent : Widget {
+		ComposerTextField* field;
+
+		void draw(const DrawArgs& args) override {
+			field->drawText(args);
+		}
+	};
+
 	ComposerTextField() {
 		multiline = false;
 		textOffset = math::Vec(0, 0);
 		fontPath = asset::plugin(pluginInstance, "res/CozetteVector.ttf");
+
+		textLayer = new TextLayer;
+		TextContent* content = new TextContent;
+		content->field = this;
+		textContent = content;
+		textLayer->addChild(textContent);
+		addChild(textLayer);
 	}
 
 	void step() override {
 		LedDisplayTextField::step();
-		// if (module && module->dirty) {
-		if (module) {
-			// setText(module->text);
-			// module->dirty = false;
+		// The baseline is below the box, the layer is as tall as a blendish widget to fit the glyphs
+		math::Vec size(parent ? parent->box.size.x : box.size.x, std::max(box.size.y, (float)BND_WIDGET_HEIGHT));
+		bool focused = this == APP->event->selectedWidget;
+		if (!textLayer->box.size.equals(size) || text != drawnText || cursor != drawnCursor || selection != drawnSelection
+				|| focused != drawnFocused) {
+			textLayer->box.size = size;
+			textContent->box.size = size;
+			drawnText = text;
+			drawnCursor = cursor;
+			drawnSelection = selection;
+			drawnFocused = focused;
+			textLayer->setDirty();
 		}
 	}
 
@@ -642,63 +801,83 @@ struct ComposerTextField : LedDisplayTextField {
 	}
 
 	void draw(const DrawArgs& args) override {
-		if (!initSizes) {
-			calculateCharacterWidth(args);
-			initSizes = true;
+		// The mouse needs the character width before the text is first drawn
+		if (metricsFont < 0) {
+			std::shared_ptr<window::Font> font = APP->window->loadFont(fontPath);
+			if (font && font->handle >= 0)
+				calculateCharacterWidth(args.vg, font->handle);
 		}
 
 		LedDisplayTextField::draw(args);
 	}
 
-	void calculateCharacterWidth(const DrawArgs& args) {
+	void calculateCharacterWidth(NVGcontext* vg, int fontHandle) {
+		if (fontHandle == metricsFont && fontSize == metricsSize)
+			return;
+		nvgFontFaceId(vg, fontHandle);
+		nvgFontSize(vg, fontSize);
+		nvgTextAlign(vg, NVG_ALIGN_LEFT|NVG_ALIGN_BASELINE);
+		static NVGglyphPosition diffglyphs[2];
+		nvgTextGlyphPositions(vg, textOffset.x, textOffset.y, "ab", NULL, diffglyphs, 2);
+		dx = diffglyphs[1].x - diffglyphs[0].x;
+		nvgTextMetrics(vg, NULL, &desc, &lh);
+		metricsFont = fontHandle;
+		metricsSize = fontSize;
+	}
+
+	float gridAlpha(int i) const {
+		return (i % gridModulo == 0) ? 0.2 : 0.08;
+	}
+
+	// Grid, text and caret, rendered into the text layer
+	void drawText(const DrawArgs& args) {
 		std::shared_ptr<window::Font> font = APP->window->loadFont(fontPath);
-		if (font && font->handle >= 0) {
-			bndSetFont(font->handle);
-			nvgFontFaceId(args.vg, font->handle);
-			nvgFontSize(args.vg, fontSize);
-			nvgTextAlign(args.vg, NVG_ALIGN_LEFT|NVG_ALIGN_BASELINE);
-			static NVGglyphPosition diffglyphs[2];
-			nvgTextGlyphPositions(args.vg, textOffset.x, textOffset.y, "ab", NULL, diffglyphs, 2);
-			dx = diffglyphs[1].x - diffglyphs[0].x;
-			nvgTextMetrics(args.vg, NULL, NULL, &lh);
+		if (!font || font->handle < 0)
+			return;
+		calculateCharacterWidth(args.vg, font->handle);
+
+		// Background grid
+		for (int i = 0; i < steps; i += bgSteps)
+		{	
+			NVGcolor gridColor = color;
+			gridColor.a = gridAlpha(i);
+			nvgBeginPath(args.vg);
+			nvgRect(args.vg, caretOffset + textRadius + i * dx * dxScale, 0.1, bgSteps * dx * dxScale * 0.9, lh); // 
+			nvgFillColor(args.vg, gridColor);
+			nvgFill(args.vg);
 		}
-	}
+		// Text
+		bndSetFont(font->handle);
 
-	void drawLayer(const DrawArgs& args, int layer) override {
-		nvgScissor(args.vg, RECT_ARGS(args.clipBox));
+		NVGcolor highlightColor = color;
+		highlightColor.a = 0.5;
+		int begin = std::min(cursor, selection);
+		int end = (this == APP->event->selectedWidget) ? std::max(cursor, selection) : -1;
 
-		if (layer == 1) {
-			calculateCharacterWidth(args);
-			// Background grid
-			for (int i = 0; i < steps; i += bgSteps)
-			{	
-				NVGcolor gridColor = color;
-				gridColor.a = ((i % gridModulo == 0) ? 0.2 : 0.08);
-				if (!noHighlight && i == stepHighlight * bgSteps) gridColor.r *= 3.0;
-				nvgBeginPath(args.vg);
-				nvgRect(args.vg, caretOffset + textRadius + i * dx * dxScale, 0.1, bgSteps * dx * dxScale * 0.9, lh); // 
-				nvgFillColor(args.vg, gridColor);
-				nvgFill(args.vg);
-			}
-			// Text
-			std::shared_ptr<window::Font> font = APP->window->loadFont(fontPath);
-			if (font && font->handle >= 0) {
-				bndSetFont(font->handle);
+		mybndIconLabelCaret(args.vg,
+			textOffset.x, textOffset.y,
+			box.size.x, box.size.y,
+			-1, color, fontSize, text.c_str(), highlightColor, begin, end, font->handle, dx, dxScale, caretOffset);
 
-				NVGcolor highlightColor = color;
-				highlightColor.a = 0.5;
-				int begin = std::min(cursor, selection);
-				int end = (this == APP->event->selectedWidget) ? std::max(cursor, selection) : -1;
+		bndSetFont(APP->window->uiFont->handle);
+	}
 
-				mybndIconLabelCaret(args.vg,
-					textOffset.x, textOffset.y,
-					box.size.x, box.size.y,
-					-1, color, fontSize, text.c_str(), highlightColor, begin, end, font->handle, dx, dxScale, caretOffset);
+	void drawLayer(const DrawArgs& args, int layer) override {
+		nvgScissor(args.vg, RECT_ARGS(args.clipBox));
 
-				bndSetFont(APP->window->uiFont->handle);
-			}
+		if (layer == 1 && !noHighlight && stepHighlight >= 0 && metricsFont >= 0) {
+			// Playhead, under the cached grid cell of the step
+			int i = stepHighlight * bgSteps;
+			NVGcolor playheadColor = color;
+			playheadColor.r *= 3.0;
+			playheadColor.a = gridAlpha(i);
+			nvgBeginPath(args.vg);
+			nvgRect(args.vg, caretOffset + textRadius + i * dx * dxScale, 0.1, bgSteps * dx * dxScale * 0.9, lh);
+			nvgFillColor(args.vg, playheadColor);
+			nvgFill(args.vg);
 		}
 
+		// Draws the text layer
 		Widget::drawLayer(args, layer);
 		nvgResetScissor(args.vg);
 	}
@@ -757,7 +936,9 @@ struct ComposerTextField : LedDisplayTextField {
 
 struct SequenceDisplay : LedDisplay {
 	AcidComposer* module;
-	ComposerSequence* targetSeq;
+	int shownIndex = 0; // pattern the fields are editing
+	int shownHighlight = -1;
+	ComposerTelemetry playhead;
 
 	ComposerTextField* headerField;
 	ComposerTextField* notesField;
@@ -765,30 +946,58 @@ struct SequenceDisplay : LedDisplay {
 	ComposerTextField* slideAccentField;
 	ComposerTextField* timeField;
 
+	void showSequence(int index) {
+		const ComposerSequence& sequence = module->sequences[index];
+		headerField->text = sequence.headerStr;
+		notesField->text = sequence.notesStr;
+		octaveField->text = sequence.octaveStr;
+		slideAccentField->text = sequence.slideAccentStr;
+		timeField->text = sequence.timeStr;
+		shownIndex = index;
+	}
+
 	void step() override {
 		if (module) {
+			if (module->editIndex != shownIndex || module->reloadEditor) {
+				showSequence(module->editIndex);
+				module->reloadEditor = false;
+			}
 			if (headerField->dirty ||
 					notesField->dirty ||
 					octaveField->dirty ||
 					slideAccentField->dirty ||
 					timeField->dirty) {
-				targetSeq->headerStr = headerField->text;
-				targetSeq->notesStr = notesField->text;
-				targetSeq->octaveStr = octaveField->text;
-				targetSeq->slideAccentStr = slideAccentField->text;
-				targetSeq->timeStr = timeField->text;
-				targetSeq->dirty = true;
+				ComposerSequence& sequence = module->sequences[shownIndex];
+				sequence.headerStr = headerField->text;
+				sequence.notesStr = notesField->text;
+				sequence.octaveStr = octaveField->text;
+				sequence.slideAccentStr = slideAccentField->text;
+				sequence.timeStr = timeField->text;
+				module->publishSequence(shownIndex);
 				headerField->dirty = false;
 				notesField->dirty = false;
 				octaveField->dirty = false;
 				slideAccentField->dirty = false;
 				timeField->dirty = false;
 			}
-			headerField->stepHighlight = module->stepIndexRun;
-			notesField->stepHighlight = module->stepIndexRun;
-			octaveField->stepHighlight = module->stepIndexRun;
-			slideAccentField->stepHighlight = module->stepIndexRun;
-			timeField->stepHighlight = module->stepIndexRun;
+			// Only follow the playhead while the edited pattern is playing, on the first track that plays it
+			while (module->telemetry.pop(&playhead)) {
+			}
+			int highlight = -1;
+			for (int t = 0; t < playhead.tracks; t++) {
+				if (playhead.patterns[t] == shownIndex) {
+					highlight = playhead.steps[t];
+					break;
+				}
+			}
+			if (highlight != shownHighlight) {
+				headerField->stepHighlight = highlight;
+				notesField->stepHighlight = highlight;
+				octaveField->stepHighlight = highlight;
+				slideAccentField->stepHighlight = highlight;
+				timeField->stepHighlight = highlight;
+				shownHighlight = highlight;
+			}
 		}
 	}
 
@@ -867,7 +1076,7 @@ struct SequenceDisplay : LedDisplay {
 			headerField->fontSize = 11;
 			headerField->gridModulo = 1;
 			headerField->steps = 8;
-			headerField->text = module->sequence.headerStr;
+			headerField->text = module->sequences[module->editIndex].headerStr;
 			headerField->dxScale = 1.3;
 			headerField->caretOffset = 0.2;
 			headerField->allowedCharacters = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+- ";
@@ -883,7 +1092,7 @@ struct SequenceDisplay : LedDisplay {
 			notesField->gridModulo = 8;
 			notesField->steps = 32;
 			notesField->bgSteps = 2;
-			notesField->text = module->sequence.notesStr;
+			notesField->text = module->sequences[module->editIndex].notesStr;
 			notesField->dxScale = 1.3;
 			notesField->caretOffset = 0.2;
 			notesField->allowedCharacters = "ABCDEFGabcdefg# ";
@@ -896,7 +1105,7 @@ struct SequenceDisplay : LedDisplay {
 			octaveField->bgColor = nvgRGBA(255, 0, 0, 30);
 			octaveField->fontSize = 11;
 			octaveField->steps = 16;
-			octaveField->text = module->sequence.octaveStr;
+			octaveField->text = module->sequences[module->editIndex].octaveStr;
 			octaveField->dxScale = 2.6;
 			octaveField->caretOffset = 0.2;
 			octaveField->allowedCharacters = "DUdu ";
@@ -911,7 +1120,7 @@ struct SequenceDisplay : LedDisplay {
 			slideAccentField->gridModulo = 8;
 			slideAccentField->steps = 32;
 			slideAccentField->bgSteps = 2;
-			slideAccentField->text = module->sequence.slideAccentStr;
+			slideAccentField->text = module->sequences[module->editIndex].slideAccentStr;
 			slideAccentField->dxScale = 1.3;
 			slideAccentField->caretOffset = 0.2;
 			slideAccentField->allowedCharacters = "SAsa ";
@@ -924,7 +1133,7 @@ struct SequenceDisplay : LedDisplay {
 			timeField->bgColor = nvgRGBA(255, 0, 0, 30);
 			timeField->fontSize = 11;
 			timeField->steps = 16;
-			timeField->text = module->sequence.timeStr;
+			timeField->text = module->sequences[module->editIndex].timeStr;
 			timeField->dxScale = 2.6;
 			timeField->caretOffset = 0.2;
 			timeField->allowedCharacters = "o_- ";
@@ -944,6 +1153,8 @@ struct SequenceDisplay : LedDisplay {
 
 			timeField->prevField = slideAccentField;
 
+			shownIndex = module->editIndex;
+
 			DEBUG("setModule");
 		}
 
@@ -963,6 +1174,15 @@ struct _303PJ301MPort : PJ301MPort {
 	}
 };
 
+struct ChainField : ui::TextField {
+	AcidComposer* module;
+
+	void onChange(const ChangeEvent& e) override {
+		module->chainStr = getText();
+		module->publishChain();
+	}
+};
+
 struct AcidComposerWidget : ModuleWidget {
 
 	struct GreenLight : GrayModuleLightWidget {
@@ -979,7 +1199,6 @@ struct AcidComposerWidget : ModuleWidget {
 		SequenceDisplay* seqDisp = createWidget<SequenceDisplay>(mm2px(Vec(11.5, 10.0)));
 		seqDisp->box.size = mm2px(Vec(72.2, 21.5));
 		seqDisp->setModule(module);
-		seqDisp->targetSeq = &module->sequence;
 		addChild(seqDisp);
 
 		// Inputs
@@ -987,6 +1206,7 @@ struct AcidComposerWidget : ModuleWidget {
 		float yGuides[] = {51.59, 101.62, 114.75};
 		addInput(createInputCentered<_303PJ301MPort>(mm2px(Vec(xGuides[0], yGuides[1])), module, AcidComposer::RESET_INPUT));
 		addInput(createInputCentered<_303PJ301MPort>(mm2px(Vec(xGuides[0], yGuides[2])), module, AcidComposer::CLOCK_INPUT));
+		addInput(createInputCentered<_303PJ301MPort>(mm2px(Vec(xGuides[2], yGuides[1])), module, AcidComposer::PATTERN_INPUT));
 		// Outputs
 		addOutput(createOutputCentered<_303PJ301MPort>(mm2px(Vec(xGuides[2], yGuides[2])), module, AcidComposer::ACCENT_OUTPUT));
 		addOutput(createOutputCentered<_303PJ301MPort>(mm2px(Vec(xGuides[3], yGuides[2])), module, AcidComposer::GATE_OUTPUT));
@@ -1002,11 +1222,152 @@ struct AcidComposerWidget : ModuleWidget {
 		addChild(createLightCentered<LEDBezelLight<RedLight>>(mm2px(Vec(xGuides[1], yGuides[1])), module, AcidComposer::RESET_LIGHT));
 	}
 
+	// Libraries hold far more patterns than fit in a menu, so they are browsed by pages of
+	// LIBRARY_PAGE and only the pages that are opened read their records
+	static constexpr int LIBRARY_PAGE = 100;
+	static constexpr int SIMILAR_PATTERNS = 20;
+
+	static MenuItem* createLibraryItem(AcidComposer* module, int index) {
+		const PatternRecord& record = module->library.record(index);
+		std::string name(record.name, strnlen(record.name, PatternRecord::NAME_SIZE));
+		std::string header = std::string(1, record.letter) + " " + std::to_string(record.length);
+		return createMenuItem(std::to_string(index + 1) + " " + name, header, [=]() {
+			module->loadLibraryPattern(index);
+		});
+	}
+
+	static void appendLibraryPage(Menu* menu, AcidComposer* module, int begin, int end) {
+		int span = 1;
+		while (span * LIBRARY_PAGE < end - begin)
+			span *= LIBRARY_PAGE;
+		if (span == 1) {
+			for (int i = begin; i < end; i++) {
+				menu->addChild(createLibraryItem(module, i));
+			}
+			return;
+		}
+		for (int b = begin; b < end; b += span) {
+			int e = std::min(b + span, end);
+			menu->addChild(createSubmenuItem(std::to_string(b + 1) + " to " + std::to_string(e), "", [=](Menu* menu) {
+				appendLibraryPage(menu, module, b, e);
+			}));
+		}
+	}
+
+	static std::string chooseFile(osdialog_file_action action, const std::string& dir, const std::string& filename, const char* filters) {
+		osdialog_filters* filtersO = osdialog_filters_parse(filters);
+		char* pathC = osdialog_file(action, dir.empty() ? NULL : dir.c_str(),
+			filename.empty() ? NULL : filename.c_str(), filtersO);
+		osdialog_filters_free(filtersO);
+		if (!pathC)
+			return "";
+		std::string path = pathC;
+		std::free(pathC);
+		return path;
+	}
+
+	static void openLibrary(AcidComposer* module) {
+		std::string dir = module->library.isOpen() ? system::getDirectory(module->library.path) : "";
+		std::string path = chooseFile(OSDIALOG_OPEN, dir, "", "Pattern library (.takp):takp");
+		if (path.empty())
+			return;
+		if (!module->library.open(path))
+			osdialog_message(OSDIALOG_WARNING, OSDIALOG_OK, ("Not a pattern library: " + path).c_str());
+	}
+
+	static void importLibrary(AcidComposer* module) {
+		std::string chartPath = chooseFile(OSDIALOG_OPEN, "", "", "Pattern charts (.txt):txt");
+		if (chartPath.empty())
+			return;
+		std::string libraryPath = chooseFile(OSDIALOG_SAVE, system::getDirectory(chartPath), system::getStem(chartPath) + ".takp",
+			"Pattern library (.takp):takp");
+		if (libraryPath.empty())
+			return;
+		if (system::getExtension(libraryPath) != ".takp")
+			libraryPath += ".takp";
+
+		// The library may be the open one, which can't be written while it is mapped on Windows.
+		// Whatever was open is opened again if the import fails.
+		std::string previousPath = module->library.isOpen() ? module->library.path : "";
+		bool reopen = !previousPath.empty() && libraryPath == previousPath;
+		if (reopen)
+			module->library.close();
+		ChartImportResult result;
+		if (!importCharts(chartPath, libraryPath, &result)) {
+			if (reopen)
+				module->library.open(previousPath);
+			osdialog_message(OSDIALOG_WARNING, OSDIALOG_OK, ("Import failed, " + result.message).c_str());
+			return;
+		}
+		if (!module->library.open(libraryPath)) {
+			if (!previousPath.empty())
+				module->library.open(previousPath);
+			osdialog_message(OSDIALOG_WARNING, OSDIALOG_OK, ("Imported, but can't open the library: " + libraryPath).c_str());
+			return;
+		}
+		std::string report = std::to_string(result.imported) + " charts imported, " + std::to_string(result.skipped) + " skipped.";
+		if (!result.message.empty())
+			report += "\nFirst problem, line " + std::to_string(result.line) + ": " + result.message;
+		osdialog_message(OSDIALOG_INFO, OSDIALOG_OK, report.c_str());
+	}
+
 	void appendContextMenu(Menu *menu) override {
 		AcidComposer *module = dynamic_cast<AcidComposer*>(this->module);
 		assert(module);
 
 		menu->addChild(createBoolPtrMenuItem("Reset on run", "", &module->resetOnRun));
+		menu->addChild(createIndexPtrSubmenuItem("Clock input", {"1 pulse per step", "24 PPQN (DIN sync)", "48 PPQN"}, &module->clockResolution));
+		menu->addChild(createIndexPtrSubmenuItem("Gate length", {"From clock", "25%", "50%", "55.8% (303)", "75%"}, &module->gateLength));
+
+		menu->addChild(new MenuSeparator);
+		std::vector<std::string> letters;
+		for (int i = 0; i < AcidComposer::PATTERNS; i++) {
+			letters.push_back(std::string(1, 'A' + i));
+		}
+		menu->addChild(createIndexSubmenuItem("Edit pattern", letters,
+			[=]() { return module->editIndex; },
+			[=](int index) { module->editIndex = index; }
+		));
+		std::vector<std::string> trackCounts;
+		for (int i = 1; i <= AcidComposer::MAX_TRACKS; i++) {
+			trackCounts.push_back(std::to_string(i));
+		}
+		menu->addChild(createIndexSubmenuItem("Tracks", trackCounts,
+			[=]() { return module->editedBank.tracks - 1; },
+			[=](int index) { module->publishTracks(index + 1); }
+		));
+		menu->addChild(createIndexPtrSubmenuItem("Pattern input", {"CV, 1/12V per pattern", "Trigger, next pattern of the chain"}, &module->patternInputMode));
+
+		menu->addChild(createMenuLabel("Chain, pattern letters played in turn"));
+		ChainField* chainField = new ChainField;
+		chainField->module = module;
+		chainField->box.size.x = 200;
+		chainField->placeholder = "Empty plays the edited pattern";
+		chainField->text = module->chainStr;
+		menu->addChild(chainField);
+
+		menu->addChild(new MenuSeparator);
+		std::string libraryName = module->library.isOpen() ? system::getFilename(module->library.path) : "";
+		menu->addChild(createSubmenuItem("Pattern library", libraryName, [=](Menu* menu) {
+			menu->addChild(createMenuItem("Open library...", "", [=]() { openLibrary(module); }));
+			menu->addChild(createMenuItem("Import charts...", "", [=]() { importLibrary(module); }));
+			if (module->library.isOpen()) {
+				menu->addChild(new MenuSeparator);
+				std::string letter(1, 'A' + module->editIndex);
+				menu->addChild(createMenuLabel(std::to_string(module->library.count) + " patterns, loaded into pattern " + letter));
+				menu->addChild(createSubmenuItem("Similar to pattern " + letter, "", [=](Menu* menu) {
+					for (const PatternIndex::Match& match : module->findSimilarPatterns(SIMILAR_PATTERNS)) {
+						menu->addChild(createLibraryItem(module, match.index));
+					}
+				}));
+				appendLibraryPage(menu, module, 0, module->library.count);
+			}
+		}));
+
+#ifdef TAK_PROFILE
+		static const char* const units[] = {"sample", "sample", "chart"};
+		appendProfileMenu(menu, &module->profile, AcidComposer::PROFILE_STAGE_NAMES, units);
+#endif
 	}
 
 };
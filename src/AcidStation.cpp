@@ -1,116 +1,47 @@
 #include "plugin.hpp"
+#include "AcidStationCore.hpp"
+#include "ComposerLink.hpp"
+#include "TelemetryRing.hpp"
+#include "WavetableOscillator.hpp"
 
-#include <slime/dsp/LadderFilter.hpp>
-#include <slime/Math.hpp>
-#include <slime/cv/Digital.hpp>
-
-struct Envelope3Generator {
-	enum class Stage {
-		IDLE,
-		ATTACK,
-		DECAY,
-		RELEASE,
-	};
-
-	static constexpr float OVERSHOOT = 1.15f;
-	static constexpr float COEFF = 2.03688192726f;  // -ln(1 - 1 / 1.15)) causes convergence at t=1
-	static constexpr float IDLE_EPS = 0.0f;
-
-	float attack_time = 0.5f;
-	float decay_time = 1.0f;
-	float value = 0.0f;
-
-	Stage stage = Stage::IDLE;
-	float target = 0.0f;
-	bool attack_triggered = false;
-	bool decay_triggered = false;
-
-	void reset() {
-		stage = Stage::IDLE;
-		target = 0.0f;
-		attack_triggered = false;
-		decay_triggered = false;
-		value = 0.0f;
-	}
-
-	void trigger() {
-		if (stage == Stage::ATTACK)
-			return;
-
-		target = OVERSHOOT;
-		stage = Stage::ATTACK;
-		attack_triggered = true;
-	}
-
-	void release() {
-		// if (stage == Stage::ATTACK || stage == Stage::IDLE)
-		// 	return;
-
-		stage = Stage::RELEASE;
-	}
-
-	float process(float delta_time) {
-		if (stage == Stage::IDLE)
-			return 0.0f;
-
-		if (stage == Stage::ATTACK) {
-			value += COEFF * delta_time * (target - value) / attack_time;
-
-			if (value > 1.0f) {
-				value = 1.0f;
-				target = 1.0f - OVERSHOOT;
-				stage = Stage::DECAY;
-				decay_triggered = true;
-			}
-		} else if (stage == Stage::DECAY || stage == Stage::RELEASE) {
-			value += COEFF * delta_time * (target - value) / ( stage == Stage::DECAY ? decay_time : 6e-3);
-
-			if (value < IDLE_EPS) {
-				value = 0.0f;
-				stage = Stage::IDLE;
-			}
-		}
-
-		return value;
-	}
+struct AcidStation : Module {
 
-	bool isIdle(void) {
-		return stage == Stage::IDLE;
-	}
+	AcidStationCore core;
+	rack::dsp::PeakFilter level_filter;
+	rack::dsp::ClockDivider level_divider, light_divider;
 
-	bool attackWasTriggered(void) {
-		bool result = attack_triggered;
-		attack_triggered = false;
-		return result;
-	}
+	enum Oscillators {
+		OSCILLATOR_EXTERNAL, // the signal input
+		OSCILLATOR_SAW,
+		OSCILLATOR_SQUARE,
+		OSCILLATORS_LEN
+	};
 
-	bool decayWasTriggered(void) {
-		bool result = decay_triggered;
-		decay_triggered = false;
-		return result;
-	}
-};
+	// One frame of each port, handed to the core
+	float in[AcidStationCore::MAX_CHANNELS] = {};
+	float pitch[AcidStationCore::MAX_CHANNELS] = {};
+	float gate[AcidStationCore::MAX_CHANNELS] = {};
+	float accent[AcidStationCore::MAX_CHANNELS] = {};
+	float cutoff[AcidStationCore::MAX_CHANNELS] = {};
+	float fm[AcidStationCore::MAX_CHANNELS] = {};
+	float out[AcidStationCore::MAX_CHANNELS] = {};
 
-struct AcidStation : Module {
+	// Published every light_divider frames, the lights are set from it on the UI thread
+	TelemetryRing<StationTelemetry> telemetry;
+	int64_t light_frame = -1;
 
-	// Mutable config
-	float eg1_decay = 1e6f;
-	float eg2_decay = 1e6f;
-	float eg2_memory = 0.0f; // "wow" filter on vcf envelope
-	float eg2_memory_last = 0.0f;
-	float eg2_memory_intensity = 0.999;
+	// Double buffer for the leftExpander messages
+	AcidStationModulation expander_messages[2];
 
-	// Internal state
-	Envelope3Generator eg1, eg2;
-	slime::cv::SchmittTrigger trigger1_filter, trigger2_filter, hold_filter;
+	// Play the AcidComposer on the right, its gates and accents replace the inputs
+	bool play_composer = false;
 
-	// Internal state
-	std::array<slime::dsp::FourPoleLadderLowpass<slime::math::float_simd>, slime::math::SIMD_PAR> filters;
-	std::array<slime::math::float_simd, slime::math::SIMD_PAR> frequency;
-	rack::dsp::PeakFilter level_filter;
-	rack::dsp::ClockDivider level_divider, param_divider, light_divider, expander_divider;
-	float drive;
-	bool accent = false;
+	// Built-in oscillator, the signal input then sets its pitch. The tables are shared by
+	// every AcidStation and only loaded once their oscillator is picked, see setOscillator().
+	int oscillator = OSCILLATOR_EXTERNAL;
+	std::shared_ptr<const Wavetable> wavetables[OSCILLATORS_LEN]; // kept until the module goes
+	std::atomic<const Wavetable*> published_wavetables[OSCILLATORS_LEN] = {}; // read by the audio thread
+	WavetableOscillator oscillators[AcidStationCore::MAX_CHANNELS / 4];
 
 	enum ParamIds { FREQ_PARAM,
 		RES_PARAM,
@@ -165,171 +96,228 @@ struct AcidStation : Module {
 		configSwitch(HOLD_PARAM, 0.0f, 1.0f, 0.0f, "Hold", {"OFF", "ON"});
 		getParamQuantity(HOLD_PARAM)->randomizeEnabled = false;
 
-		param_divider.setDivision(8);  // Min 5512 Hz
 		light_divider.setDivision(512);
-		expander_divider.setDivision(8192);
 		level_divider.setDivision(64);
 		level_filter.setLambda(5.0f);
 
+		// Written by AcidStationExpander and read in place by the core, see AcidStationModulation
+		leftExpander.producerMessage = &expander_messages[0];
+		leftExpander.consumerMessage = &expander_messages[1];
+
+		core.setSampleRate(APP->engine->getSampleRate());
+		core.setNoiseSeed(random::u32());
 		onReset();
 	}
 
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		core.setSampleRate(e.sampleRate);
+	}
+
 	void onReset(void) override {
-		for (auto& filter : filters) {
-			filter.reset();
+		core.reset();
+		for (auto& osc : oscillators) {
+			osc.reset();
 		}
-
 		level_filter.reset();
 		level_divider.reset();
-		param_divider.reset();
 		light_divider.reset();
-		frequency.fill(20.0f * rack::dsp::approxExp2_taylor5<slime::math::float_simd>(slime::math::LOG_2_10 * 1.5f));
+	}
 
-		eg1.attack_time = std::pow(10.0f, -2.522878f);
-		eg2.attack_time = std::pow(10.0f, -2.522878f);
-		eg1.reset();
-		eg2.reset();
+	// Loads the table of `index` if needed and switches to it. The oscillator plays the signal
+	// input until the table is published. Not for the audio thread: called from the menu and
+	// from dataFromJson(), which Rack runs on the UI thread.
+	void setOscillator(int index) {
+		static const char* const paths[OSCILLATORS_LEN] = {nullptr, "res/wt-saw-2048-62.wav", "res/wt-pulse-2048-62.wav"};
+		if (paths[index] && !wavetables[index]) {
+			wavetables[index] = Wavetable::load(asset::plugin(pluginInstance, paths[index]), 2048);
+			published_wavetables[index].store(wavetables[index].get(), std::memory_order_release);
+		}
+		oscillator = index;
+	}
 
-		drive = 9.5f;
+	// The composer to play this frame, as latched at the end of the last one, see
+	// ComposerLink.hpp. Also sends the decision for the next frame, once per frame.
+	Module* linkComposer() {
+		Module* composer = rightExpander.module;
+		if (!composer || composer->model != modelAcidComposer)
+			return nullptr;
+
+		const ComposerLinkMessage* latched = static_cast<const ComposerLinkMessage*>(composer->leftExpander.consumerMessage);
+		bool played = latched->station == this;
+
+		ComposerLinkMessage* next = static_cast<ComposerLinkMessage*>(composer->leftExpander.producerMessage);
+		next->station = (play_composer && !composer->isBypassed()) ? this : nullptr;
+		composer->leftExpander.requestMessageFlip();
+
+		return played ? composer : nullptr;
+	}
+
+	// Voices past the composer's tracks: a single track plays all of them, as a mono cable
+	// would through getPolyVoltage(), otherwise they are silent
+	static float spreadTrack(const float* voltages, int tracks) {
+		return (tracks == 1) ? voltages[0] : 0.0f;
 	}
 
 	void process(const ProcessArgs& args) override {
-		size_t channels = std::max(std::max(inputs[SIGNAL_INPUT].getChannels(), inputs[FREQ_INPUT].getChannels()),
-								   inputs[FM_INPUT].getChannels());
+		// The sequencer runs first, so its edges are seen on this frame
+		Module* composer = linkComposer();
+		int tracks = composer ? playComposer(composer, args, pitch, gate, accent) : 0;
+
+		int channels = std::max(std::max(inputs[SIGNAL_INPUT].getChannels(), inputs[FREQ_INPUT].getChannels()),
+								inputs[FM_INPUT].getChannels());
+		if (core.polyphonic) {
+			channels = std::max(channels, composer ? tracks
+				: std::max(inputs[GATE_INPUT].getChannels(), inputs[ACCENT_INPUT].getChannels()));
+		}
 		if (channels < 1) {
 			channels = 1;
 		}
 
 		outputs[SIGNAL_OUTPUT].setChannels(channels);
 
-		// Update params
-		if (param_divider.process()) {
-			slime::math::float_simd base_res = params[RES_PARAM].getValue();
+		// Params and modulation are only read by the core on control ticks
+		if (core.controlPending()) {
+			core.params.freq = params[FREQ_PARAM].getValue();
+			core.params.res = params[RES_PARAM].getValue();
+			core.params.fm_amount = params[FM_AMOUNT_PARAM].getValue();
+			core.params.vca_decay = params[VCA_DECAY_PARAM].getValue();
+			core.params.vcf_decay = params[VCF_DECAY_PARAM].getValue();
+			core.params.envmod = params[ENVMOD_PARAM].getValue();
+			core.params.accent = params[ACCENT_PARAM].getValue();
+			core.params.hold = params[HOLD_PARAM].getValue();
+			core.params.drive = params[DRIVE_PARAM].getValue();
+
+			bool expander = leftExpander.module && leftExpander.module->model == modelAcidStationExpander;
+			core.modulation = expander ? static_cast<AcidStationModulation*>(leftExpander.consumerMessage) : nullptr;
+		}
 
-			hold_filter.process(params[HOLD_PARAM].getValue() * 2.0f);
-			if (hold_filter.isRising()) {
-				eg1_decay = 1.0; // 10000ms
-				eg1.decay_time = std::pow(10.0f, eg1_decay);
+		const Wavetable* wavetable = published_wavetables[oscillator].load(std::memory_order_acquire);
+		if (wavetable) {
+			// Pitch from the composer when it is played, from the signal input otherwise
+			for (int c = composer ? tracks : 0; c < channels; c++) {
+				pitch[c] = composer ? spreadTrack(pitch, tracks) : inputs[SIGNAL_INPUT].getPolyVoltage(c);
 			}
-			if (hold_filter.isFalling()) {
-				eg1_decay = params[VCA_DECAY_PARAM].getValue();
-				eg1.decay_time = std::pow(10.0f, eg1_decay);
+			for (int c = 0; c < channels; c += 4) {
+				simd::float_4 voices = oscillators[c / 4].process(*wavetable, simd::float_4::load(&pitch[c]), args.sampleTime);
+				voices.store(&in[c]);
 			}
-
-			if (!hold_filter.isHigh()) {
-				if (eg1_decay != params[VCA_DECAY_PARAM].getValue()) {
-					eg1_decay = params[VCA_DECAY_PARAM].getValue();
-					eg1.decay_time = std::pow(10.0f, eg1_decay);
-				}
+		} else {
+			for (int c = 0; c < channels; c++) {
+				in[c] = inputs[SIGNAL_INPUT].getPolyVoltage(c);
 			}
-
-			if (eg2_decay != params[VCF_DECAY_PARAM].getValue() && !accent) {
-				eg2_decay = params[VCF_DECAY_PARAM].getValue();
-				eg2.decay_time = std::pow(10.0f, eg2_decay);
+		}
+		if (composer) {
+			for (int c = tracks; c < channels; c++) {
+				gate[c] = spreadTrack(gate, tracks);
+				accent[c] = spreadTrack(accent, tracks);
 			}
+		} else {
+			for (int c = 0; c < channels; c++) {
+				gate[c] = inputs[GATE_INPUT].getPolyVoltage(c);
+			}
+		}
 
-			for (size_t ch = 0; ch < channels; ch += slime::math::float_simd::size) {
-				size_t simd_index = ch / slime::math::float_simd::size;
-
-				auto* filter = &filters[simd_index];
+		// Without accents the core runs its envelopes without the accent logic
+		bool accented = composer || inputs[ACCENT_INPUT].isConnected();
+		if (accented && !composer) {
+			for (int c = 0; c < channels; c++) {
+				accent[c] = inputs[ACCENT_INPUT].getPolyVoltage(c);
+			}
+		} else if (!accented && core.accent_patched) {
+			std::fill(std::begin(accent), std::end(accent), 0.0f);
+		}
+		core.accent_patched = accented;
+
+		// The cutoff follows the Cutoff and FM inputs on every frame while either is patched
+		bool modulated = inputs[FREQ_INPUT].isConnected() || inputs[FM_INPUT].isConnected();
+		if (modulated) {
+			for (int c = 0; c < channels; c++) {
+				cutoff[c] = inputs[FREQ_INPUT].getPolyVoltage(c);
+				fm[c] = inputs[FM_INPUT].getPolyVoltage(c);
+			}
+		}
 
-				// Resonance from expander
-				slime::math::float_simd res = base_res;
+		core.process(in, gate, accent, modulated ? cutoff : nullptr, modulated ? fm : nullptr, out, 1, channels);
 
-				res = rack::simd::clamp(res, 0.0f, 1.2f);
+		outputs[SIGNAL_OUTPUT].writeVoltages(out);
 
-				filter->setResonance(res);
-			}
+		if (level_divider.process()) {
+			level_filter.process(args.sampleTime * static_cast<float>(level_divider.division), core.drive_level);
+		}
 
-			drive = 9.5f - 9.0f * params[DRIVE_PARAM].getValue();
+		if (light_divider.process()) {
+			StationTelemetry record;
+			record.frame = args.frame;
+			core.telemetry(&record, channels);
+			record.drive_level = level_filter.out;
+			telemetry.publish(record);
 		}
+	}
 
-		trigger2_filter.process(2.0f * inputs[ACCENT_INPUT].getVoltage());
-		trigger1_filter.process(2.0f * inputs[GATE_INPUT].getVoltage());
+	// The composer is still played while the station is bypassed
+	void processBypass(const ProcessArgs& args) override {
+		Module* composer = linkComposer();
+		if (composer)
+			playComposer(composer, args, pitch, gate, accent);
+		Module::processBypass(args);
+	}
 
-		if (trigger1_filter.isRising()) {
-			// Kinda S&H accent input to gate
-			// Accent should come on the same edge as gate
-			if (trigger2_filter.isRising() && !accent) {
-				accent = true;
-				eg2_decay = -0.7; // 200ms
-				eg2.decay_time = std::pow(10.0f, eg2_decay);
+	// UI thread, from AcidStationWidget::step()
+	void updateLights() {
+		StationTelemetry record;
+		while (telemetry.pop(&record)) {
+			// Timestamps give the time between records, even when some were dropped
+			float delta = (light_frame < 0) ? 0.0f : (record.frame - light_frame) * APP->engine->getSampleTime();
+			delta = math::clamp(delta, 0.0f, 1.0f);
+			light_frame = record.frame;
+
+			bool vca_decaying = false;
+			bool vcf_decaying = false;
+			for (int voice = 0; voice < AcidStationCore::MAX_CHANNELS; voice++) {
+				vca_decaying |= StationTelemetry::stage(record.vca_stages, voice) == StationTelemetry::DECAY;
+				vcf_decaying |= StationTelemetry::stage(record.vcf_stages, voice) == StationTelemetry::DECAY;
 			}
-			if (!trigger2_filter.isHigh() && accent) {
-				accent = false;
-				eg2.release();
-				eg2_decay = params[VCF_DECAY_PARAM].getValue();
-				eg2.decay_time = std::pow(10.0f, eg2_decay);
-			}
-			eg1.trigger();
-			eg2.trigger();
-		}
-		if (trigger1_filter.isFalling()) {
-			if (!hold_filter.isHigh()) eg1.release();
-			if (!accent && !hold_filter.isHigh()) eg2.release();
+			lights[VCA_DECAY_LIGHT].setSmoothBrightness(vca_decaying ? 1.0f : 0.0f, delta * 0.1f);
+			lights[VCF_DECAY_LIGHT].setSmoothBrightness(vcf_decaying ? 1.0f : 0.0f, delta * 0.1f);
+			lights[DRIVE_LIGHT].setBrightness(record.drive_level - 1.0f);
 		}
+	}
 
-		eg1.process(args.sampleTime);
-		eg2.process(args.sampleTime);
-
-		eg2_memory = (eg2.value * accent) * (1 - eg2_memory_intensity) + eg2_memory_last * eg2_memory_intensity;
-		eg2_memory_last = eg2_memory;
-
-		// Cutoff param updates continuously while the envelope is active or when the divider just triggered
-		if (param_divider.clock == 0 || !eg2.isIdle()) {
-			for (size_t ch = 0; ch < channels; ch += slime::math::float_simd::size) {
-				size_t simd_index = ch / slime::math::float_simd::size;
-
-				auto* filter = &filters[simd_index];
-				float eg2_mix = (eg2.value - 0.3137) + (accent ? eg2.value * params[ACCENT_PARAM].getValue() * (1.0f - params[RES_PARAM].getValue())
-					+ eg2_memory * 1.5 * params[ACCENT_PARAM].getValue() * params[RES_PARAM].getValue() : 0.0f);
-				slime::math::float_simd pitch = rack::simd::clamp(
-				params[FREQ_PARAM].getValue() + (eg2_mix * 2.0f * params[ENVMOD_PARAM].getValue()) + inputs[FREQ_INPUT].getPolyVoltageSimd<slime::math::float_simd>(ch) +
-					params[FM_AMOUNT_PARAM].getValue() * inputs[FM_INPUT].getPolyVoltageSimd<slime::math::float_simd>(ch),
-					0.0f, slime::math::LOG_2_10 * 3.0f);
-				slime::math::float_simd freq = 20.0f * rack::dsp::approxExp2_taylor5<slime::math::float_simd>(pitch);
-				filter->setCutoffFrequency(freq);
-			}
-		}
+	json_t* dataToJson() override {
+		json_t* rootJ = json_object();
 
-		slime::math::float_simd signal, clipped;
-		// Run filter
-		for (size_t ch = 0; ch < channels; ch += slime::math::float_simd::size) {
-			size_t simd_index = ch / slime::math::float_simd::size;
-			auto* filter = &filters[simd_index];
-
-			slime::math::float_simd in = inputs[SIGNAL_INPUT].getPolyVoltageSimd<slime::math::float_simd>(ch);
-			in += 1e-6f * (2.0f * rack::random::uniform() - 1.0f);
-			filter->process(args.sampleTime, in);
-
-			float vca_env = (eg1.value * eg1.value) + (accent ? eg2.value * eg2.value * params[ACCENT_PARAM].getValue() :  0.0f);
-
-			signal = filter->lowpass4() * vca_env;
-			clipped = 9.0f * slime::math::tanh_rational5(signal / drive);
-			outputs[SIGNAL_OUTPUT].setVoltageSimd(clipped, ch);
-			float eg2_mix = (eg2.value - 0.3137) + (accent ? eg2.value * params[ACCENT_PARAM].getValue() * (1.0f - params[RES_PARAM].getValue())
-				+ eg2_memory * 1.5 * params[ACCENT_PARAM].getValue() * params[RES_PARAM].getValue() : 0.0f);
-			slime::math::float_simd pitch = rack::simd::clamp(
-			params[FREQ_PARAM].getValue() + (eg2_mix * 2.0f * params[ENVMOD_PARAM].getValue()) + inputs[FREQ_INPUT].getPolyVoltageSimd<slime::math::float_simd>(ch) +
-				params[FM_AMOUNT_PARAM].getValue() * inputs[FM_INPUT].getPolyVoltageSimd<slime::math::float_simd>(ch),
-				0.0f, slime::math::LOG_2_10 * 3.0f);
-		}
+		json_object_set_new(rootJ, "polyphonic", json_boolean(core.polyphonic));
+		json_object_set_new(rootJ, "oversampling", json_integer(core.oversampling));
+		json_object_set_new(rootJ, "driveMode", json_integer(core.drive_mode));
+		json_object_set_new(rootJ, "playComposer", json_boolean(play_composer));
+		json_object_set_new(rootJ, "oscillator", json_integer(oscillator));
 
-		if (level_divider.process()) {
-			level_filter.process(args.sampleTime * static_cast<float>(level_divider.division),
-								 std::abs(clipped[0] - signal[0]));
-		}
+		return rootJ;
+	}
 
-		// Lights
-		if (light_divider.process()) {
-			lights[VCA_DECAY_LIGHT].setSmoothBrightness(
-				(eg1.decayWasTriggered() || (eg1.stage == Envelope3Generator::Stage::DECAY)) ? 1.0f : 0.0f,
-				args.sampleTime * light_divider.division * 0.1f);
-			lights[VCF_DECAY_LIGHT].setSmoothBrightness(
-				(eg2.decayWasTriggered() || (eg2.stage == Envelope3Generator::Stage::DECAY)) ? 1.0f : 0.0f,
-				args.sampleTime * light_divider.division * 0.1f);
-			lights[DRIVE_LIGHT].setBrightness(level_filter.out - 1.0f);
+	void dataFromJson(json_t* rootJ) override {
+		json_t* polyphonicJ = json_object_get(rootJ, "polyphonic");
+		if (polyphonicJ)
+			core.polyphonic = json_is_true(polyphonicJ);
+
+		json_t* oversamplingJ = json_object_get(rootJ, "oversampling");
+		if (oversamplingJ) {
+			int factor = json_integer_value(oversamplingJ);
+			if (factor == 1 || factor == 2 || factor == 4 || factor == 8)
+				core.oversampling = factor;
 		}
+
+		json_t* driveModeJ = json_object_get(rootJ, "driveMode");
+		if (driveModeJ)
+			core.drive_mode = math::clamp((int)json_integer_value(driveModeJ), 0, AcidStationCore::DRIVE_MODES_LEN - 1);
+
+		json_t* playComposerJ = json_object_get(rootJ, "playComposer");
+		if (playComposerJ)
+			play_composer = json_is_true(playComposerJ);
+
+		json_t* oscillatorJ = json_object_get(rootJ, "oscillator");
+		if (oscillatorJ)
+			setOscillator(math::clamp((int)json_integer_value(oscillatorJ), 0, OSCILLATORS_LEN - 1));
 	}
 };
 
@@ -395,6 +383,35 @@ struct AcidStationWidget : ModuleWidget {
 					 module, AcidStation::DRIVE_LIGHT + i));
 		}
 	}
+
+	void step() override {
+		AcidStation* module = dynamic_cast<AcidStation*>(this->module);
+		if (module)
+			module->updateLights();
+		ModuleWidget::step();
+	}
+
+	void appendContextMenu(Menu *menu) override {
+		AcidStation *module = dynamic_cast<AcidStation*>(this->module);
+		assert(module);
+
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createBoolPtrMenuItem("Polyphonic gate and accent", "", &module->core.polyphonic));
+		menu->addChild(createIndexSubmenuItem("Oversampling", {"1x", "2x", "4x", "8x"},
+			[=]() { return (size_t)std::log2(module->core.oversampling); },
+			[=](size_t index) { module->core.oversampling = 1 << index; }
+		));
+		menu->addChild(createIndexPtrSubmenuItem("Drive", {"Plain", "Anti-aliased (ADAA)"}, &module->core.drive_mode));
+		menu->addChild(createBoolPtrMenuItem("Play the AcidComposer on the right", "", &module->play_composer));
+		menu->addChild(createIndexSubmenuItem("Oscillator", {"Signal input", "Saw, pitch from the signal input", "Square, pitch from the signal input"},
+			[=]() { return (size_t)module->oscillator; },
+			[=](size_t index) { module->setOscillator(index); }
+		));
+
+#ifdef TAK_PROFILE
+		appendProfileMenu(menu, &module->core.profile, AcidStationCore::PROFILE_STAGE_NAMES);
+#endif
+	}
 };
 
 Model* modelAcidStation = createModel<AcidStation, AcidStationWidget>("AcidStation");
\ No newline at end of file
@@ -0,0 +1,509 @@
+#include "AcidStationCore.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using float_simd = slime::math::float_simd;
+
+// Loads or stores the first `lanes` channels of a SIMD block, so buffers don't need to be padded
+static inline float_simd loadLanes(const float* p, int lanes) {
+	if (lanes >= float_simd::size)
+		return float_simd::load(p);
+
+	float tmp[float_simd::size] = {};
+	for (int i = 0; i < lanes; i++)
+		tmp[i] = p[i];
+	return float_simd::load(tmp);
+}
+
+// Decay param (log10 of the time in seconds) to decay time, per lane
+static inline float_simd decayTime(float_simd decay) {
+	return rack::simd::exp(rack::simd::clamp(decay, -3.0f, 1.0f) * (float)M_LN10);
+}
+
+// Cutoff pitch in octaves above 20Hz to frequency
+static inline float_simd cutoffFrequency(float_simd pitch) {
+	return 20.0f * rack::dsp::approxExp2_taylor5<float_simd>(rack::simd::clamp(pitch, 0.0f, slime::math::LOG_2_10 * 3.0f));
+}
+
+static inline void storeLanes(float* p, float_simd v, int lanes) {
+	if (lanes >= float_simd::size) {
+		v.store(p);
+		return;
+	}
+
+	for (int i = 0; i < lanes; i++)
+		p[i] = v[i];
+}
+
+// Needed in C++14 since std::min takes them by reference
+constexpr int AcidStationCore::MAX_CHANNELS;
+
+const char* const AcidStationCore::PROFILE_STAGE_NAMES[PROFILE_STAGES_LEN] = {"Control", "Envelopes", "Ladder", "Drive"};
+
+AcidStationCore::AcidStationCore() {
+	setSampleRate(44100.0f);
+	reset();
+}
+
+void AcidStationCore::setSampleRate(float sample_rate) {
+	sample_time = 1.0f / sample_rate;
+	control_division = std::max(1, (int)std::round(sample_rate / CONTROL_RATE));
+	control_counter = std::min(control_counter, control_division);
+
+	float tick_time = sample_time * control_division;
+	eg2_memory_coeff = std::exp(-tick_time / EG2_MEMORY_TIME);
+	accent_decay_coeff = Envelope3Generator::coefficient(std::pow(10.0f, ACCENT_DECAY), sample_time);
+	for (size_t i = 0; i < slime::math::SIMD_PAR; i++) {
+		eg1[i].setTimes(ATTACK_TIME, 1.0f, sample_time);
+		eg2[i].setTimes(ATTACK_TIME, 1.0f, sample_time);
+	}
+
+	// The decays stay the same, only their per-sample coefficients change
+	float vca_decay = hold_filter.isHigh() ? HOLD_DECAY : eg1_decay;
+	eg1_decay_coeff = Envelope3Generator::coefficient(std::pow(10.0f, vca_decay), sample_time);
+	eg2_decay_coeff = Envelope3Generator::coefficient(std::pow(10.0f, eg2_decay), sample_time);
+}
+
+void AcidStationCore::reset() {
+	for (auto& filter : filters) {
+		filter.reset();
+	}
+	for (auto& oversampler : oversamplers) {
+		oversampler.reset();
+	}
+	for (auto& saturator : saturators) {
+		saturator.reset();
+	}
+	for (size_t i = 0; i < slime::math::SIMD_PAR; i++) {
+		noise[i].seed(noise_seed * slime::math::SIMD_PAR + i);
+	}
+
+	control_counter = 0;
+	pitch.fill(slime::math::LOG_2_10 * 1.5f);
+	pitch_step.fill(0.0f);
+	pitch_target = pitch;
+	frequency.fill(cutoffFrequency(pitch[0]));
+	frequency_step.fill(0.0f);
+	frequency_target = frequency;
+	resonance.fill(0.0f);
+	resonance_step.fill(0.0f);
+	resonance_target = resonance;
+	ramping.fill(false);
+	sleeping.fill(false);
+	filter_sleeping.fill(false);
+	silent_frames.fill(0);
+
+	for (size_t i = 0; i < slime::math::SIMD_PAR; i++) {
+		eg1[i].reset();
+		eg2[i].reset();
+		trigger1_filter[i].reset();
+		trigger2_filter[i].reset();
+		accent_on[i] = 0.0f;
+		accent_pending[i] = false;
+		eg2_memory[i] = 0.0f;
+		accent_amount[i] = params.accent;
+		eg2_decay_coeffs[i] = eg2_decay_coeff;
+		filters[i].setCutoffFrequency(frequency[i]);
+	}
+
+	drive = 9.5f;
+	drive_level = 0.0f;
+}
+
+void AcidStationCore::setNoiseSeed(uint32_t seed) {
+	noise_seed = seed;
+	for (size_t i = 0; i < slime::math::SIMD_PAR; i++) {
+		noise[i].seed(noise_seed * slime::math::SIMD_PAR + i);
+	}
+}
+
+// Runs once every control_division frames: snapshots params, updates the envelope
+// decays and sets up linear cutoff and resonance ramps to the new modulation targets.
+// The modulated kernels ramp the pitch instead, and add the Cutoff and FM voltages to it.
+void AcidStationCore::processControl(int channels) {
+	ProfileClock clock;
+	control = params;
+
+	hold_filter.process(control.hold * 2.0f);
+	if (hold_filter.isRising()) {
+		eg1_decay = HOLD_DECAY;
+		eg1_decay_coeff = Envelope3Generator::coefficient(std::pow(10.0f, eg1_decay), sample_time);
+	}
+	if (hold_filter.isFalling() || (!hold_filter.isHigh() && eg1_decay != control.vca_decay)) {
+		eg1_decay = control.vca_decay;
+		eg1_decay_coeff = Envelope3Generator::coefficient(std::pow(10.0f, eg1_decay), sample_time);
+	}
+	if (eg2_decay != control.vcf_decay) {
+		eg2_decay = control.vcf_decay;
+		eg2_decay_coeff = Envelope3Generator::coefficient(std::pow(10.0f, eg2_decay), sample_time);
+	}
+
+	drive = 9.5f - 9.0f * control.drive;
+
+	float ramp = 1.0f / control_division;
+	for (int ch = 0; ch < channels; ch += float_simd::size) {
+		size_t simd_index = ch / float_simd::size;
+		int lanes = channels - ch;
+		float_simd& acc_on = accent_on[simd_index];
+		float_simd res = control.res;
+		float_simd accent = control.accent;
+		float_simd envmod = control.envmod;
+		float_simd eg1_coeff = eg1_decay_coeff;
+		float_simd eg2_coeff = eg2_decay_coeff;
+
+		// Resonance, accent, envmod and decays from the expander
+		if (modulation && ch < modulation->channels) {
+			int modulated_lanes = std::min(lanes, modulation->channels - ch);
+			res += loadLanes(&modulation->res[ch], modulated_lanes);
+			accent = rack::simd::clamp(accent + loadLanes(&modulation->accent[ch], modulated_lanes), 0.0f, 1.0f);
+			envmod = rack::simd::clamp(envmod + loadLanes(&modulation->envmod[ch], modulated_lanes), 0.0f, 1.0f);
+			if (!hold_filter.isHigh()) {
+				float_simd vca_decay = eg1_decay + loadLanes(&modulation->vca_decay[ch], modulated_lanes);
+				eg1_coeff = Envelope3Generator::coefficient(decayTime(vca_decay), sample_time);
+			}
+			float_simd vcf_decay = eg2_decay + loadLanes(&modulation->vcf_decay[ch], modulated_lanes);
+			eg2_coeff = Envelope3Generator::coefficient(decayTime(vcf_decay), sample_time);
+		}
+		res = rack::simd::clamp(res, 0.0f, 1.2f);
+
+		eg1[simd_index].decay_coeff = eg1_coeff;
+		eg2[simd_index].decay_coeff = rack::simd::ifelse(acc_on, accent_decay_coeff, eg2_coeff);
+		eg2_decay_coeffs[simd_index] = eg2_coeff;
+		accent_amount[simd_index] = accent;
+
+		float_simd eg2_value = eg2[simd_index].value;
+		eg2_memory[simd_index] = rack::simd::ifelse(acc_on, eg2_value, 0.0f) * (1.0f - eg2_memory_coeff)
+			+ eg2_memory[simd_index] * eg2_memory_coeff;
+
+		float_simd eg2_mix = (eg2_value - 0.3137f) + rack::simd::ifelse(acc_on,
+			eg2_value * accent * (1.0f - res) + eg2_memory[simd_index] * 1.5f * accent * res, 0.0f);
+		float_simd target = control.freq + (eg2_mix * 2.0f * envmod);
+		float_simd freq = cutoffFrequency(target);
+
+		pitch_target[simd_index] = target;
+		frequency_target[simd_index] = freq;
+		resonance_target[simd_index] = res;
+		pitch_step[simd_index] = (target - pitch[simd_index]) * ramp;
+		frequency_step[simd_index] = (freq - frequency[simd_index]) * ramp;
+		resonance_step[simd_index] = (res - resonance[simd_index]) * ramp;
+		ramping[simd_index] = rack::simd::movemask((frequency_step[simd_index] != 0.0f) | (resonance_step[simd_index] != 0.0f)) != 0;
+	}
+	profile.add(PROFILE_CONTROL, clock.lap(), channels * control_division);
+}
+
+// Runs one SIMD block over frames [start, end), which never cross a control tick.
+// Without ACCENT the accent buffer isn't read: it must be all zeros, and no accent on or
+// pending in the block, so the accent logic would have no effect. Without MODULATED the
+// cutoff and FM buffers aren't read.
+template <bool POLYPHONIC, bool ACCENT, bool OVERSAMPLED, bool ADAA, bool MODULATED>
+void AcidStationCore::processBlock(size_t simd_index, const float* in, const float* gate, const float* accent,
+								   const float* cutoff, const float* fm, float* out, int start, int end, int channels) {
+	int ch = simd_index * float_simd::size;
+	int lanes = std::min(channels - ch, (int)float_simd::size); // voices in this block, as counted by the profile
+	// Hold keeps the gates from releasing the envelopes
+	const float_simd release_mask = hold_filter.isHigh() ? float_simd(0.0f) : float_simd::mask();
+
+	// The state is updated in place. The Rack module runs a single frame per call, where copying
+	// it to locals and back costs more than it saves, and longer blocks run as fast either way.
+	Envelope3Generator& env1 = eg1[simd_index];
+	Envelope3Generator& env2 = eg2[simd_index];
+	SchmittTriggerSimd& gate_trigger = trigger1_filter[simd_index];
+	SchmittTriggerSimd& accent_trigger = trigger2_filter[simd_index];
+	float_simd& acc_on = accent_on[simd_index];
+	const float_simd accent_level = accent_amount[simd_index];
+	const float_simd eg2_coeff = eg2_decay_coeffs[simd_index];
+	float_simd& freq = frequency[simd_index];
+	float_simd& res = resonance[simd_index];
+	float_simd& knob_pitch = pitch[simd_index];
+	auto& filter = filters[simd_index];
+	auto& oversampler = oversamplers[simd_index];
+	TanhADAA& saturator = saturators[simd_index];
+	NoiseSimd& dither = noise[simd_index];
+	const bool ramp = ramping[simd_index];
+	bool& asleep = sleeping[simd_index];
+	bool& filter_asleep = filter_sleeping[simd_index];
+	int& quiet_frames = silent_frames[simd_index];
+	const int factor = oversampler.factor;
+	const float oversampled_time = sample_time / factor;
+	float_simd signal = 0.0f, clipped = 0.0f;
+	ProfileClock clock;
+
+	// Audio rate cutoff, the ramped knob and envelope pitch plus the Cutoff and FM voltages
+	auto modulatedCutoff = [&](size_t offset) {
+		return cutoffFrequency(knob_pitch + loadLanes(cutoff + offset + ch, lanes)
+			+ control.fm_amount * loadLanes(fm + offset + ch, lanes));
+	};
+
+	for (int frame = start; frame < end; frame++) {
+		size_t offset = (size_t)frame * channels;
+		clock.lap();
+
+		// Envelopes, one lane per voice. In mono mode every lane follows channel 0.
+		if (POLYPHONIC) {
+			gate_trigger.process(2.0f * loadLanes(gate + offset + ch, lanes));
+		} else {
+			gate_trigger.process(2.0f * gate[offset]);
+		}
+
+		if (ACCENT) {
+			if (POLYPHONIC) {
+				accent_trigger.process(2.0f * loadLanes(accent + offset + ch, lanes));
+			} else {
+				accent_trigger.process(2.0f * accent[offset]);
+			}
+
+			// Kinda S&H accent input to gate
+			// Accent should come on the same edge as gate
+			float_simd accent_rising = gate_trigger.isRising() & accent_trigger.isRising() & ~acc_on;
+			float_simd accent_falling = gate_trigger.isRising() & ~accent_trigger.isHigh() & acc_on;
+			acc_on = (acc_on | accent_rising) & ~accent_falling;
+			env2.decay_coeff = rack::simd::ifelse(accent_rising | accent_falling,
+				rack::simd::ifelse(acc_on, accent_decay_coeff, eg2_coeff), env2.decay_coeff);
+			env2.release(accent_falling);
+		}
+
+		env1.trigger(gate_trigger.isRising());
+		env2.trigger(gate_trigger.isRising());
+
+		float_simd released = gate_trigger.isFalling() & release_mask;
+		env1.release(released);
+		env2.release(ACCENT ? released & ~acc_on : released);
+
+		env1.process();
+		env2.process();
+		profile.add(PROFILE_ENVELOPES, clock.lap(), lanes);
+
+		// Filter. With the Cutoff or FM input patched the cutoff follows them on every frame.
+		if (MODULATED) {
+			knob_pitch += pitch_step[simd_index];
+			res += resonance_step[simd_index];
+			if (!filter_asleep) {
+				freq = modulatedCutoff(offset);
+				filter.setCutoffFrequency(freq);
+				filter.setResonance(res);
+			}
+		} else if (ramp) {
+			freq += frequency_step[simd_index];
+			res += resonance_step[simd_index];
+			if (!filter_asleep) {
+				filter.setCutoffFrequency(freq);
+				filter.setResonance(res);
+			}
+		}
+
+		// Nothing can be heard while the envelopes feeding the VCA are idle. A sleeping block
+		// skips the drive and outputs zeros, but its filter runs on, so that the voice sounds
+		// the same when the gate wakes it up. The filter only stops once it has decayed on a
+		// silent input, where the little state it is left with can't be heard either.
+		bool vca_idle = rack::simd::movemask(ACCENT ? env1.isIdle() & (env2.isIdle() | ~acc_on) : env1.isIdle()) == 0xF;
+		float_simd x = loadLanes(in + offset + ch, lanes);
+		if (asleep) {
+			float_simd silent = (rack::simd::fabs(x) < SLEEP_THRESHOLD) & (rack::simd::fabs(filter.lowpass4()) < SLEEP_THRESHOLD);
+			if (!vca_idle || rack::simd::movemask(silent) != 0xF) {
+				quiet_frames = 0;
+				if (filter_asleep) {
+					filter_asleep = false;
+					if (MODULATED) {
+						freq = modulatedCutoff(offset);
+					}
+					filter.setCutoffFrequency(freq);
+					filter.setResonance(res);
+				}
+			} else if (!filter_asleep && ++quiet_frames >= SLEEP_FRAMES) {
+				filter_asleep = true;
+			}
+
+			// Wake up on the frame the gate comes in
+			asleep = vca_idle;
+			if (filter_asleep) {
+				storeLanes(out + offset + ch, 0.0f, lanes);
+				continue;
+			}
+		}
+
+		x += 1e-6f * dither.process();
+
+		float_simd vca_env = env1.value * env1.value;
+		if (ACCENT) {
+			vca_env += rack::simd::ifelse(acc_on, env2.value * env2.value * accent_level, 0.0f);
+		}
+
+		uint64_t ladder_ticks = 0, drive_ticks = 0;
+		if (!OVERSAMPLED) {
+			filter.process(sample_time, x);
+			ladder_ticks += clock.lap();
+			if (!asleep) {
+				signal = filter.lowpass4() * vca_env;
+				clipped = 9.0f * (ADAA ? saturator.process(signal / drive) : slime::math::tanh_rational5(signal / drive));
+				drive_ticks += clock.lap();
+			}
+		} else {
+			// Only the filter and the saturator run at the oversampled rate
+			float_simd buffer[Oversampler<float_simd>::MAX_FACTOR];
+			oversampler.upsample(x, buffer);
+			for (int i = 0; i < factor; i++) {
+				filter.process(oversampled_time, buffer[i]);
+				ladder_ticks += clock.lap();
+				if (!asleep) {
+					signal = filter.lowpass4() * vca_env;
+					buffer[i] = 9.0f * (ADAA ? saturator.process(signal / drive) : slime::math::tanh_rational5(signal / drive));
+					drive_ticks += clock.lap();
+				}
+			}
+			if (!asleep) {
+				clipped = oversampler.downsample(buffer);
+				ladder_ticks += clock.lap();
+			}
+		}
+		profile.add(PROFILE_LADDER, ladder_ticks, lanes);
+		profile.add(PROFILE_DRIVE, drive_ticks, lanes);
+
+		// Go to sleep once the VCA has been idle for a while, whatever the input. The drive and
+		// the downsamplers have then been fed nothing but zeros, so resetting them changes nothing.
+		if (!asleep) {
+			if (vca_idle) {
+				if (++quiet_frames >= SLEEP_FRAMES) {
+					asleep = true;
+					quiet_frames = 0;
+					oversampler.resetDownsampling();
+					saturator.reset();
+					signal = 0.0f;
+					clipped = 0.0f;
+				}
+			} else {
+				quiet_frames = 0;
+			}
+		}
+
+		storeLanes(out + offset + ch, clipped, lanes);
+	}
+
+	if (ACCENT) {
+		accent_pending[simd_index] = rack::simd::movemask(acc_on | accent_trigger.isHigh()) != 0;
+	}
+	if (!MODULATED)
+		knob_pitch += pitch_step[simd_index] * (float)(end - start);
+
+	if (simd_index == 0) {
+		drive_level = std::abs(clipped[0] - signal[0]);
+	}
+}
+
+template <int VARIANT>
+static constexpr AcidStationCore::BlockKernel blockKernel() {
+	return &AcidStationCore::processBlock<(VARIANT & AcidStationCore::VARIANT_POLYPHONIC) != 0,
+		(VARIANT & AcidStationCore::VARIANT_ACCENT) != 0, (VARIANT & AcidStationCore::VARIANT_OVERSAMPLED) != 0,
+		(VARIANT & AcidStationCore::VARIANT_ADAA) != 0, (VARIANT & AcidStationCore::VARIANT_MODULATED) != 0>;
+}
+
+const AcidStationCore::BlockKernel AcidStationCore::BLOCK_KERNELS[VARIANTS_LEN] = {
+	blockKernel<0>(), blockKernel<1>(), blockKernel<2>(), blockKernel<3>(),
+	blockKernel<4>(), blockKernel<5>(), blockKernel<6>(), blockKernel<7>(),
+	blockKernel<8>(), blockKernel<9>(), blockKernel<10>(), blockKernel<11>(),
+	blockKernel<12>(), blockKernel<13>(), blockKernel<14>(), blockKernel<15>(),
+	blockKernel<16>(), blockKernel<17>(), blockKernel<18>(), blockKernel<19>(),
+	blockKernel<20>(), blockKernel<21>(), blockKernel<22>(), blockKernel<23>(),
+	blockKernel<24>(), blockKernel<25>(), blockKernel<26>(), blockKernel<27>(),
+	blockKernel<28>(), blockKernel<29>(), blockKernel<30>(), blockKernel<31>(),
+};
+
+void AcidStationCore::process(const float* in, const float* gate, const float* accent, const float* cutoff,
+							  const float* fm, float* out, int frames, int channels) {
+	channels = std::max(1, std::min(channels, MAX_CHANNELS));
+	active_blocks = (channels + float_simd::size - 1) / float_simd::size;
+
+	if (drive_mode != active_drive_mode) {
+		for (auto& saturator : saturators) {
+			saturator.reset();
+		}
+		active_drive_mode = drive_mode;
+	}
+
+	if (oversampling != oversamplers[0].factor) {
+		for (auto& oversampler : oversamplers) {
+			oversampler.setFactor(oversampling);
+		}
+	}
+
+	// Every block runs the same variant, but for the accent which only runs while it can
+	// change something
+	int variant = (polyphonic ? VARIANT_POLYPHONIC : 0)
+		| (oversamplers[0].factor > 1 ? VARIANT_OVERSAMPLED : 0)
+		| (active_drive_mode == DRIVE_ADAA ? VARIANT_ADAA : 0)
+		| (cutoff ? VARIANT_MODULATED : 0);
+
+	int frame = 0;
+	while (frame < frames) {
+		if (control_counter == 0) {
+			processControl(channels);
+			control_counter = control_division;
+		}
+
+		// Process each block up to the next control tick
+		int end = std::min(frames, frame + control_counter);
+		for (size_t simd_index = 0; simd_index < active_blocks; simd_index++) {
+			bool accented = accent_patched || accent_pending[simd_index];
+			BlockKernel kernel = BLOCK_KERNELS[variant | (accented ? VARIANT_ACCENT : 0)];
+			(this->*kernel)(simd_index, in, gate, accent, cutoff, fm, out, frame, end, channels);
+		}
+
+		control_counter -= end - frame;
+		frame = end;
+
+		// Adding the steps doesn't land exactly on the targets. The next steps would then be
+		// too small to move the values, but not zero, and the filter updated on every frame.
+		// The modulated cutoff isn't ramped, it stays where the inputs left it.
+		if (control_counter == 0) {
+			for (size_t simd_index = 0; simd_index < active_blocks; simd_index++) {
+				pitch[simd_index] = pitch_target[simd_index];
+				resonance[simd_index] = resonance_target[simd_index];
+				if (!cutoff) {
+					frequency[simd_index] = frequency_target[simd_index];
+				}
+			}
+		}
+	}
+}
+
+static uint32_t envelopeStages(Envelope3Generator& eg, int block) {
+	int attack = rack::simd::movemask(eg.attack);
+	int decay = rack::simd::movemask(eg.decayWasTriggered() | eg.decay);
+	int releasing = rack::simd::movemask(eg.releasing);
+	uint32_t stages = 0;
+	for (int lane = 0; lane < 4; lane++) {
+		int stage = (decay & (1 << lane)) ? StationTelemetry::DECAY
+			: (attack & (1 << lane)) ? StationTelemetry::ATTACK
+			: (releasing & (1 << lane)) ? StationTelemetry::RELEASE
+			: StationTelemetry::IDLE;
+		stages |= stage << ((block * 4 + lane) * 2);
+	}
+	return stages;
+}
+
+void AcidStationCore::telemetry(StationTelemetry* record, int channels) {
+	record->vca_stages = 0;
+	record->vcf_stages = 0;
+	record->accents = 0;
+	for (size_t i = 0; i < slime::math::SIMD_PAR; i++) {
+		if (i >= active_blocks) {
+			for (int lane = 0; lane < 4; lane++) {
+				record->vca_levels[i * 4 + lane] = 0;
+				record->vcf_levels[i * 4 + lane] = 0;
+			}
+			continue;
+		}
+		record->vca_stages |= envelopeStages(eg1[i], i);
+		record->vcf_stages |= envelopeStages(eg2[i], i);
+		record->accents |= rack::simd::movemask(accent_on[i]) << (i * 4);
+		for (int lane = 0; lane < 4; lane++) {
+			record->vca_levels[i * 4 + lane] = (uint8_t)(rack::math::clamp(eg1[i].value[lane], 0.0f, 1.0f) * 255.0f);
+			record->vcf_levels[i * 4 + lane] = (uint8_t)(rack::math::clamp(eg2[i].value[lane], 0.0f, 1.0f) * 255.0f);
+		}
+	}
+	// Voices past the channel count are left over from earlier patches
+	uint32_t voices = (channels >= 16) ? 0xffffffffu : (1u << (channels * 2)) - 1;
+	record->vca_stages &= voices;
+	record->vcf_stages &= voices;
+	record->accents &= (1u << channels) - 1;
+}
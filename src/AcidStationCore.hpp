@@ -0,0 +1,302 @@
+#pragma once
+#include <array>
+#include <rack.hpp>
+
+#include <slime/dsp/LadderFilter.hpp>
+#include <slime/Math.hpp>
+#include <slime/cv/Digital.hpp>
+
+#include "AcidStationModulation.hpp"
+#include "Noise.hpp"
+#include "Oversampler.hpp"
+#include "Profiler.hpp"
+#include "Saturator.hpp"
+
+// Four lanes of the 303 envelope. Stage changes are tracked as per-lane masks
+// so that every voice can be triggered and released independently without branching.
+struct Envelope3Generator {
+	using T = slime::math::float_simd;
+
+	static constexpr float OVERSHOOT = 1.15f;
+	static constexpr float COEFF = 2.03688192726f;  // -ln(1 - 1 / 1.15)) causes convergence at t=1
+	static constexpr float IDLE_EPS = 0.0f;
+	static constexpr float RELEASE_TIME = 6e-3f;
+
+	// Per-sample decay factors towards the target, see coefficient()
+	T attack_coeff = 0.0f;
+	T decay_coeff = 0.0f;
+	T release_coeff = 0.0f;
+	T value = 0.0f;
+	T target = 0.0f;
+
+	// Stage masks, a lane with no stage set is idle
+	T attack = 0.0f;
+	T decay = 0.0f;
+	T releasing = 0.0f;
+	T attack_triggered = 0.0f;
+	T decay_triggered = 0.0f;
+
+	// Exact one-pole discretization of the stage time constant, so the curves
+	// don't depend on the sample rate
+	static float coefficient(float time, float delta_time) {
+		return std::exp(-COEFF * delta_time / time);
+	}
+
+	static T coefficient(T time, float delta_time) {
+		return rack::simd::exp(-COEFF * delta_time / time);
+	}
+
+	void setTimes(float attack_time, float decay_time, float delta_time) {
+		attack_coeff = coefficient(attack_time, delta_time);
+		decay_coeff = coefficient(decay_time, delta_time);
+		release_coeff = coefficient(RELEASE_TIME, delta_time);
+	}
+
+	void reset() {
+		target = 0.0f;
+		attack = 0.0f;
+		decay = 0.0f;
+		releasing = 0.0f;
+		attack_triggered = 0.0f;
+		decay_triggered = 0.0f;
+		value = 0.0f;
+	}
+
+	void trigger(T mask) {
+		mask = mask & ~attack;
+
+		target = rack::simd::ifelse(mask, T(OVERSHOOT), target);
+		attack = attack | mask;
+		decay = decay & ~mask;
+		releasing = releasing & ~mask;
+		attack_triggered = attack_triggered | mask;
+	}
+
+	void release(T mask) {
+		attack = attack & ~mask;
+		decay = decay & ~mask;
+		releasing = releasing | mask;
+	}
+
+	T process() {
+		T active = attack | decay | releasing;
+		T coeff = rack::simd::ifelse(attack, attack_coeff, rack::simd::ifelse(decay, decay_coeff, release_coeff));
+		value = rack::simd::ifelse(active, target + (value - target) * coeff, value);
+
+		T to_decay = attack & (value > 1.0f);
+		value = rack::simd::ifelse(to_decay, T(1.0f), value);
+		target = rack::simd::ifelse(to_decay, T(1.0f - OVERSHOOT), target);
+		attack = attack & ~to_decay;
+		decay_triggered = decay_triggered | to_decay;
+
+		T to_idle = (decay | releasing) & (value < IDLE_EPS);
+		value = rack::simd::ifelse(to_idle, T(0.0f), value);
+		decay = (decay | to_decay) & ~to_idle;
+		releasing = releasing & ~to_idle;
+
+		return value;
+	}
+
+	T isIdle(void) {
+		return ~(attack | decay | releasing);
+	}
+
+	T attackWasTriggered(void) {
+		T result = attack_triggered;
+		attack_triggered = 0.0f;
+		return result;
+	}
+
+	T decayWasTriggered(void) {
+		T result = decay_triggered;
+		decay_triggered = 0.0f;
+		return result;
+	}
+};
+
+// Per-lane Schmitt trigger reporting rising and falling edges as masks
+struct SchmittTriggerSimd {
+	using T = slime::math::float_simd;
+
+	T state = 0.0f;
+	T rising = 0.0f;
+	T falling = 0.0f;
+
+	void reset() {
+		state = 0.0f;
+		rising = 0.0f;
+		falling = 0.0f;
+	}
+
+	void process(T in, float low = 0.5f, float high = 1.0f) {
+		T next = (in >= high) | (state & ~(in <= low));
+		rising = next & ~state;
+		falling = state & ~next;
+		state = next;
+	}
+
+	T isRising() { return rising; }
+	T isFalling() { return falling; }
+	T isHigh() { return state; }
+};
+
+// Voice state shown by the UI, one cache line with its sequence number in a TelemetryRing
+struct StationTelemetry {
+	enum Stage {
+		IDLE,
+		ATTACK,
+		DECAY, // also while releasing, and when a decay started and ended since the last record
+		RELEASE,
+	};
+
+	int64_t frame = 0; // engine frame it was taken on
+	uint32_t vca_stages = 0; // two bits per voice
+	uint32_t vcf_stages = 0;
+	uint8_t vca_levels[16] = {}; // envelopes, 255 at the peak
+	uint8_t vcf_levels[16] = {};
+	uint16_t accents = 0; // voice mask
+	float drive_level = 0.0f; // AcidStationCore::drive_level through the module's peak filter
+
+	static int stage(uint32_t stages, int voice) {
+		return (stages >> (voice * 2)) & 3;
+	}
+};
+
+// The AcidStation voice (envelopes, accent logic, ladder filters and drive), apart from
+// the module's ports and params so it can be rendered offline or benchmarked. It still
+// builds on the Rack SDK for rack::simd, rack::dsp and rack::math.
+// Buffers are interleaved frame by frame, sample `c` of frame `f` is at `f * channels + c`.
+struct AcidStationCore {
+	using float_simd = slime::math::float_simd;
+
+	enum DriveMode {
+		DRIVE_PLAIN,
+		DRIVE_ADAA, // antiderivative anti-aliased, cheaper than oversampling for big patches
+		DRIVE_MODES_LEN
+	};
+
+	enum ProfileStages {
+		PROFILE_CONTROL, // params, modulation and the cutoff exponential, spread over the tick
+		PROFILE_ENVELOPES,
+		PROFILE_LADDER,
+		PROFILE_DRIVE,
+		PROFILE_STAGES_LEN
+	};
+	static const char* const PROFILE_STAGE_NAMES[PROFILE_STAGES_LEN];
+
+	static constexpr int MAX_CHANNELS = 16;
+	static constexpr float ACCENT_DECAY = -0.7f; // 200ms
+	static constexpr float HOLD_DECAY = 1.0f; // 10000ms
+	static constexpr float ATTACK_TIME = 3e-3f; // 10^-2.522878
+	static constexpr float CONTROL_RATE = 6000.0f; // Hz, modulation and param updates
+	static constexpr float EG2_MEMORY_TIME = 22.66e-3f; // 0.999 per sample at 44.1kHz
+	static constexpr float SLEEP_THRESHOLD = 1e-4f; // about -100dB below a 10V signal
+	static constexpr int SLEEP_FRAMES = 256;
+
+	// Knob values, in the units of the AcidStation params
+	struct Params {
+		float freq = slime::math::LOG_2_10 * 1.5f;
+		float res = 0.0f;
+		float fm_amount = 0.0f;
+		float vca_decay = 0.919078f;
+		float vcf_decay = -0.187086f;
+		float envmod = 0.0f;
+		float accent = 0.5f;
+		float hold = 0.0f;
+		float drive = 0.0f;
+	};
+
+	// Set by the caller at any time, snapshotted at the next control tick
+	Params params;
+	bool polyphonic = false; // read gate and accent per channel instead of following channel 0
+	bool accent_patched = true; // false while the accent buffer is all zeros, the accent logic is then skipped
+	int oversampling = 1; // 1, 2, 4 or 8 for the filter and drive, applied on the next process()
+	int drive_mode = DRIVE_PLAIN;
+
+	// Control rate state
+	Params control;
+	float eg1_decay = Params().vca_decay;
+	float eg2_decay = Params().vcf_decay;
+	float eg1_decay_coeff = 0.0f;
+	float eg2_decay_coeff = 0.0f;
+	float accent_decay_coeff = 0.0f;
+	float eg2_memory_coeff = 0.0f; // per control tick
+	float sample_time = 1.0f / 44100.0f;
+	int control_division = 1;
+	int control_counter = 0;
+	float drive = 9.5f;
+	const AcidStationModulation* modulation = nullptr; // per-channel offsets, read in place on control ticks
+
+	// Internal state, one envelope pair per SIMD block
+	std::array<Envelope3Generator, slime::math::SIMD_PAR> eg1, eg2;
+	std::array<SchmittTriggerSimd, slime::math::SIMD_PAR> trigger1_filter, trigger2_filter;
+	std::array<float_simd, slime::math::SIMD_PAR> accent_on;
+	std::array<bool, slime::math::SIMD_PAR> accent_pending; // accent on or its trigger high, see processBlock
+	std::array<float_simd, slime::math::SIMD_PAR> eg2_memory; // "wow" filter on vcf envelope
+	std::array<float_simd, slime::math::SIMD_PAR> accent_amount, eg2_decay_coeffs; // per lane, with modulation
+	slime::cv::SchmittTrigger hold_filter;
+
+	std::array<slime::dsp::FourPoleLadderLowpass<float_simd>, slime::math::SIMD_PAR> filters;
+	std::array<Oversampler<float_simd>, slime::math::SIMD_PAR> oversamplers;
+	std::array<TanhADAA, slime::math::SIMD_PAR> saturators;
+	std::array<NoiseSimd, slime::math::SIMD_PAR> noise; // dither keeping the filter out of denormals
+	uint32_t noise_seed = 0;
+	int active_drive_mode = DRIVE_PLAIN;
+	// Ramps over a control tick, set exactly to their targets at its end
+	std::array<float_simd, slime::math::SIMD_PAR> frequency, frequency_step, frequency_target;
+	std::array<float_simd, slime::math::SIMD_PAR> pitch, pitch_step, pitch_target; // knob and envelope part of the cutoff, in octaves
+	std::array<float_simd, slime::math::SIMD_PAR> resonance, resonance_step, resonance_target;
+	std::array<bool, slime::math::SIMD_PAR> ramping;
+	// Blocks skip the drive while their VCA is idle, and the filter as well once it has
+	// decayed on a silent input, see processBlock
+	std::array<bool, slime::math::SIMD_PAR> sleeping, filter_sleeping;
+	std::array<int, slime::math::SIMD_PAR> silent_frames;
+	size_t active_blocks = 1;
+	float drive_level = 0.0f; // distance between the clean and driven signal of channel 0
+	Profile<PROFILE_STAGES_LEN> profile; // empty unless built with TAK_PROFILE
+
+	AcidStationCore();
+
+	void setSampleRate(float sample_rate);
+	void reset();
+
+	// The dither restarts from this seed on every reset(), so renders are bit-reproducible
+	void setNoiseSeed(uint32_t seed);
+
+	// True when the next processed frame starts a control tick, so params should be up to date
+	bool controlPending() const {
+		return control_counter == 0;
+	}
+
+	// `cutoff` and `fm` are the Cutoff and FM voltages, read on every frame so that the filter
+	// can be modulated at audio rate. Both are null while neither input is patched, the cutoff
+	// then only moves with the knob and the envelope, ramped at the control rate.
+	void process(const float* in, const float* gate, const float* accent, const float* cutoff, const float* fm,
+				 float* out, int frames, int channels);
+
+	// Snapshot of the envelopes and accents of the first `channels` voices. Decays that
+	// started since the last snapshot show, however short they were.
+	void telemetry(StationTelemetry* record, int channels);
+
+	void processControl(int channels);
+
+	// processBlock is compiled once for every combination of the flags below, so that the
+	// per-sample loop has no branch on the configuration and no read of an unused input.
+	// process() picks the variant of each block before running it.
+	enum BlockVariants {
+		VARIANT_POLYPHONIC = 1,
+		VARIANT_ACCENT = 2,
+		VARIANT_OVERSAMPLED = 4,
+		VARIANT_ADAA = 8,
+		VARIANT_MODULATED = 16,
+		VARIANTS_LEN = 32
+	};
+	using BlockKernel = void (AcidStationCore::*)(size_t simd_index, const float* in, const float* gate, const float* accent,
+												  const float* cutoff, const float* fm, float* out, int start, int end,
+												  int channels);
+	static const BlockKernel BLOCK_KERNELS[VARIANTS_LEN];
+
+	template <bool POLYPHONIC, bool ACCENT, bool OVERSAMPLED, bool ADAA, bool MODULATED>
+	void processBlock(size_t simd_index, const float* in, const float* gate, const float* accent, const float* cutoff,
+					  const float* fm, float* out, int start, int end, int channels);
+};
@@ -0,0 +1,134 @@
+#include "plugin.hpp"
+#include "AcidStationCore.hpp"
+
+struct AcidStationExpander : Module {
+
+	rack::dsp::ClockDivider update_divider, light_divider;
+
+	enum ParamIds {
+		RES_AMOUNT_PARAM,
+		ACCENT_AMOUNT_PARAM,
+		ENVMOD_AMOUNT_PARAM,
+		VCA_DECAY_AMOUNT_PARAM,
+		VCF_DECAY_AMOUNT_PARAM,
+		PARAMS_LEN
+	};
+	enum InputIds {
+		RES_INPUT,
+		ACCENT_INPUT,
+		ENVMOD_INPUT,
+		VCA_DECAY_INPUT,
+		VCF_DECAY_INPUT,
+		INPUTS_LEN
+	};
+	enum OutputId {
+		OUTPUTS_LEN
+	};
+	enum LightIds {
+		CONNECTED_LIGHT,
+		LIGHTS_LEN
+	};
+
+	// Full scale of each input at 10V, in the units of the AcidStation param
+	static constexpr float RES_SCALE = 1.2f / 10.0f;
+	static constexpr float ACCENT_SCALE = 1.0f / 10.0f;
+	static constexpr float ENVMOD_SCALE = 1.0f / 10.0f;
+	static constexpr float DECAY_SCALE = 4.0f / 10.0f; // decades
+
+	AcidStationExpander() {
+		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+
+		configInput(RES_INPUT, "Resonance");
+		configInput(ACCENT_INPUT, "Accent amount");
+		configInput(ENVMOD_INPUT, "Envelope modulation");
+		configInput(VCA_DECAY_INPUT, "VCA Decay");
+		configInput(VCF_DECAY_INPUT, "VCF Decay");
+
+		configParam(RES_AMOUNT_PARAM, -1.0f, 1.0f, 0.0f, "Resonance CV amount", "%", 0.0f, 100.0f);
+		configParam(ACCENT_AMOUNT_PARAM, -1.0f, 1.0f, 0.0f, "Accent amount CV amount", "%", 0.0f, 100.0f);
+		configParam(ENVMOD_AMOUNT_PARAM, -1.0f, 1.0f, 0.0f, "Envelope modulation CV amount", "%", 0.0f, 100.0f);
+		configParam(VCA_DECAY_AMOUNT_PARAM, -1.0f, 1.0f, 0.0f, "VCA Decay CV amount", "%", 0.0f, 100.0f);
+		configParam(VCF_DECAY_AMOUNT_PARAM, -1.0f, 1.0f, 0.0f, "VCF Decay CV amount", "%", 0.0f, 100.0f);
+
+		light_divider.setDivision(512);
+		setUpdateRate(APP->engine->getSampleRate());
+	}
+
+	// AcidStation only reads the modulation on its control ticks
+	void setUpdateRate(float sample_rate) {
+		update_divider.setDivision(std::max(1, (int)std::round(sample_rate / AcidStationCore::CONTROL_RATE)));
+	}
+
+	void onSampleRateChange(const SampleRateChangeEvent& e) override {
+		setUpdateRate(e.sampleRate);
+	}
+
+	void write(float* dest, int input, int param, float scale, int channels) {
+		float amount = params[param].getValue() * scale;
+		for (int c = 0; c < channels; c++) {
+			dest[c] = inputs[input].getPolyVoltage(c) * amount;
+		}
+	}
+
+	void process(const ProcessArgs& args) override {
+		Module* station = rightExpander.module;
+		bool connected = station && station->model == modelAcidStation;
+
+		if (connected && update_divider.process()) {
+			// Written straight into the preallocated message of the AcidStation
+			AcidStationModulation* message = static_cast<AcidStationModulation*>(station->leftExpander.producerMessage);
+
+			int channels = 0;
+			for (int i = 0; i < INPUTS_LEN; i++) {
+				channels = std::max(channels, inputs[i].getChannels());
+			}
+			// Monophonic CV modulates every voice
+			if (channels <= 1) {
+				channels = AcidStationModulation::MAX_CHANNELS;
+			}
+
+			message->channels = channels;
+			write(message->res, RES_INPUT, RES_AMOUNT_PARAM, RES_SCALE, channels);
+			write(message->accent, ACCENT_INPUT, ACCENT_AMOUNT_PARAM, ACCENT_SCALE, channels);
+			write(message->envmod, ENVMOD_INPUT, ENVMOD_AMOUNT_PARAM, ENVMOD_SCALE, channels);
+			write(message->vca_decay, VCA_DECAY_INPUT, VCA_DECAY_AMOUNT_PARAM, DECAY_SCALE, channels);
+			write(message->vcf_decay, VCF_DECAY_INPUT, VCF_DECAY_AMOUNT_PARAM, DECAY_SCALE, channels);
+			station->leftExpander.requestMessageFlip();
+		}
+
+		if (light_divider.process()) {
+			lights[CONNECTED_LIGHT].setBrightness(connected ? 1.0f : 0.0f);
+		}
+	}
+};
+
+struct _303Trimpot : RoundSmallBlackKnob {
+    _303Trimpot() {
+        setSvg(Svg::load(asset::plugin(pluginInstance, "res/303Knob_0_24.svg")));
+        bg->setSvg(Svg::load(asset::plugin(pluginInstance, "")));
+    }
+};
+
+struct _303PJ301MPort : PJ301MPort {
+	_303PJ301MPort() {
+        setSvg(Svg::load(asset::plugin(pluginInstance, "res/PJ301M_acid.svg")));
+	}
+};
+
+struct AcidStationExpanderWidget : ModuleWidget {
+	AcidStationExpanderWidget(AcidStationExpander* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/AcidStationExpander_vector.svg")));
+
+		// One row per modulation, trimpot on the left and input on the right
+		float rows[] = {24.0f, 42.0f, 60.0f, 78.0f, 96.0f};
+		for (size_t i = 0; i < AcidStationExpander::INPUTS_LEN; i++) {
+			addParam(createParamCentered<_303Trimpot>(mm2px(Vec(7.62f, rows[i])), module, AcidStationExpander::RES_AMOUNT_PARAM + i));
+			addInput(createInputCentered<_303PJ301MPort>(mm2px(Vec(17.78f, rows[i])), module, AcidStationExpander::RES_INPUT + i));
+		}
+
+		addChild(createLightCentered<SmallLight<WhiteLight>>(mm2px(Vec(12.7f, 112.0f)), module, AcidStationExpander::CONNECTED_LIGHT));
+	}
+};
+
+Model* modelAcidStationExpander = createModel<AcidStationExpander, AcidStationExpanderWidget>("AcidStationExpander");
@@ -0,0 +1,15 @@
+#pragma once
+
+// Per-channel modulation sent by AcidStationExpander to the AcidStation on its right,
+// through AcidStation's leftExpander messages. Values are offsets in the units of the
+// matching AcidStation params, added to the knob values at the control rate.
+struct AcidStationModulation {
+	static constexpr int MAX_CHANNELS = 16;
+
+	int channels = 0;
+	float res[MAX_CHANNELS] = {};
+	float accent[MAX_CHANNELS] = {};
+	float envmod[MAX_CHANNELS] = {};
+	float vca_decay[MAX_CHANNELS] = {};
+	float vcf_decay[MAX_CHANNELS] = {};
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+// Follows a clock input. Rising edges are timed to a fraction of a sample, and the pulse
+// period is the median of the last few intervals, so gates can be made at a fixed duty
+// cycle without the jitter or pulse width of the upstream clock. High resolution clocks
+// (24 PPQN DIN sync) are divided down to steps.
+struct ClockFollower {
+	static constexpr int HISTORY = 5;
+	static constexpr float LOW = 0.1f;
+	static constexpr float HIGH = 1.0f;
+
+	int division = 1; // input pulses per step
+
+	int64_t frame = 0;
+	float last_input = 0.0f;
+	bool high = false;
+	bool pulsed = false; // a pulse started on the last processed sample
+	int pulse = 0; // pulses since the start of the step
+	double last_edge = 0.0;
+	bool has_edge = false;
+	double intervals[HISTORY] = {};
+	int intervals_len = 0;
+	int intervals_pos = 0;
+	double pulse_period = 0.0; // in samples, 0 until two pulses have been seen
+	double step_start = 0.0;
+
+	// Returns true when a step starts on this sample
+	bool process(float in) {
+		bool step = false;
+		pulsed = false;
+		if (!high && in >= HIGH) {
+			high = true;
+			pulsed = true;
+			// Crossing of the threshold between the previous sample and this one
+			double fraction = (in > last_input) ? (HIGH - last_input) / (in - last_input) : 1.0;
+			double edge = frame - 1 + std::min(std::max(fraction, 0.0), 1.0);
+			if (has_edge) {
+				addInterval(edge - last_edge);
+			}
+			last_edge = edge;
+			has_edge = true;
+
+			if (++pulse >= division) {
+				pulse = 0;
+				step_start = edge;
+				step = true;
+			}
+		} else if (high && in <= LOW) {
+			high = false;
+		}
+		last_input = in;
+		frame++;
+		return step;
+	}
+
+	void addInterval(double interval) {
+		intervals[intervals_pos] = interval;
+		intervals_pos = (intervals_pos + 1) % HISTORY;
+		if (intervals_len < HISTORY)
+			intervals_len++;
+
+		double sorted[HISTORY];
+		std::copy(intervals, intervals + intervals_len, sorted);
+		std::sort(sorted, sorted + intervals_len);
+		pulse_period = sorted[intervals_len / 2];
+	}
+
+	// Starts a step on the current sample, or on the pulse that was just found
+	void restart() {
+		pulse = 0;
+		step_start = pulsed ? last_edge : (double)(frame - 1);
+	}
+
+	bool hasPeriod() const {
+		return pulse_period > 0.0;
+	}
+
+	double stepPeriod() const {
+		return pulse_period * division;
+	}
+
+	// High for the first `duty` of the step, timed from the sub-sample step start
+	bool gate(float duty) const {
+		return (frame - 1) - step_start < duty * stepPeriod();
+	}
+};
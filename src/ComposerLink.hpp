@@ -0,0 +1,21 @@
+#pragma once
+#include "plugin.hpp"
+
+// An AcidStation can play the AcidComposer directly on its right: the sequencer then runs
+// inside the station's process() and its gates and accents reach the envelopes on the
+// frame they change, instead of a cable delay later and in whatever order the engine runs
+// the two modules. The composer keeps writing its outputs, and skips its own process()
+// while it is played. The pitch goes along too, for the station's own oscillator.
+
+//
+// The two modules run on different threads, so they must agree on who runs the sequencer
+// without reading each other's live state. The station writes its decision into the
+// composer's leftExpander messages every frame. The engine flips them between frames, so
+// both modules read the same latched decision for the whole of the next one.
+struct ComposerLinkMessage {
+	Module* station = nullptr; // the station playing the composer, only ever compared
+};
+
+// Defined in AcidComposer.cpp. Runs one frame of the sequencer and copies the CV, gate and
+// accent outputs of its tracks, returns the number of tracks.
+int playComposer(Module* composer, const Module::ProcessArgs& args, float* cv, float* gate, float* accent);
@@ -0,0 +1,124 @@
+// StepAttributes is adapted from ImpromptuModular PhraseSeq16
+// PhraseSeq16 is copyright © 2018-2021 Marc Boulé and is licensed under the terms of the GNU GPL either v3 or later
+
+#pragma once
+#include <cstdint>
+
+// PS16
+class StepAttributes {
+	unsigned short attributes;
+	
+	public:
+
+	static const unsigned short ATT_ST_GATE = 0x01;
+	static const unsigned short ATT_ST_ACCENT = 0x04;
+	static const unsigned short ATT_ST_SLIDE = 0x08;
+	static const unsigned short ATT_ST_TIED = 0x10;
+	
+	static const unsigned short ATT_ST_INIT =  ATT_ST_GATE;
+	
+	inline void clear() {attributes = 0u;}
+	inline void init() {attributes = ATT_ST_INIT;}
+	
+	inline bool getGate() const {return (attributes & ATT_ST_GATE) != 0;}
+	inline bool getAccent() const {return (attributes & ATT_ST_ACCENT) != 0;}
+	inline bool getSlide() const {return (attributes & ATT_ST_SLIDE) != 0;}
+	inline bool getTie() const {return (attributes & ATT_ST_TIED) != 0;}
+	inline unsigned short getAttribute() const {return attributes;}
+
+	inline void setGate(bool gateState) {attributes &= ~ATT_ST_GATE; if (gateState) attributes |= ATT_ST_GATE;}
+	inline void setAccent(bool accentState) {attributes &= ~ATT_ST_ACCENT; if (accentState) attributes |= ATT_ST_ACCENT;}
+	inline void setSlide(bool slideState) {attributes &= ~ATT_ST_SLIDE; if (slideState) attributes |= ATT_ST_SLIDE;}
+	inline void setTie(bool tiedState) {
+		attributes &= ~ATT_ST_TIED; 
+		if (tiedState) {
+			attributes |= ATT_ST_TIED;
+			attributes &= ~(ATT_ST_GATE | ATT_ST_ACCENT | ATT_ST_SLIDE);// clear other attributes if tied
+		}
+	}
+	inline void setAttribute(unsigned short _attributes) {attributes = _attributes;}
+
+	inline void toggleGate() {attributes ^= ATT_ST_GATE;}
+	inline void toggleAccent() {attributes ^= ATT_ST_ACCENT;}
+	inline void toggleSlide() {attributes ^= ATT_ST_SLIDE;}
+};// class StepAttributes
+
+// What the sequencer does on one step, worked out from the step and its neighbours when
+// the pattern is compiled so that playing it is a single table read
+struct ComposerStep {
+	enum GateMode : uint8_t {
+		GATE_LOW,
+		GATE_FOLLOW, // copy the clock
+		GATE_HIGH, // tied or sliding into the next step
+	};
+
+	float cv = 0.0f; // note, octave and transpose, in V
+	uint8_t gate = GATE_LOW;
+	bool latch = false; // the step starts a note, its cv, accent and slide are held until the next one
+	bool accent = false;
+	bool slide = false;
+};
+
+// A sequence compiled from its chart lines, immutable once handed to the audio thread
+struct ComposerPattern {
+	static constexpr int MAX_STEPS = 16;
+	static constexpr uint32_t ALL_STEPS = (1u << MAX_STEPS) - 1;
+	static constexpr float SEMITONE = 1.0 / 12.0;
+
+	float notes[MAX_STEPS] = {}; // note and octave, in V
+	StepAttributes attributes[MAX_STEPS];
+	float transpose = 0.0f;
+	char letter = 'A';
+	uint8_t length = MAX_STEPS;
+	ComposerStep program[MAX_STEPS];
+
+	ComposerPattern() {
+		for (int i = 0; i < MAX_STEPS; ++i) {
+			attributes[i].clear();
+		}
+	}
+
+	// Steps past the length never play, the last step wraps around to the first
+	int nextStep(int step) const {
+		return step + 1 < length ? step + 1 : 0;
+	}
+
+	int previousStep(int step) const {
+		return step > 0 ? step - 1 : length - 1;
+	}
+};
+
+// The compiled programs of every pattern of the bank and the chain they are played in.
+// Struct of arrays so that playing a pattern only touches one line of CVs and a quarter
+// line of step flags, and switching patterns is nothing more than a change of index.
+struct ComposerBank {
+	static constexpr int PATTERNS = 16; // A to P
+	static constexpr int MAX_CHAIN = 64;
+	// Step flags, the gate mode is in the low bits
+	static constexpr uint8_t GATE_MASK = 0x03;
+	static constexpr uint8_t LATCH = 0x04;
+	static constexpr uint8_t ACCENT = 0x08;
+	static constexpr uint8_t SLIDE = 0x10;
+
+	float cv[PATTERNS][ComposerPattern::MAX_STEPS] = {};
+	uint8_t steps[PATTERNS][ComposerPattern::MAX_STEPS] = {};
+	uint8_t lengths[PATTERNS];
+	uint8_t chain[MAX_CHAIN] = {};
+	uint8_t chain_length = 0; // empty when not in song mode
+	uint8_t tracks = 1; // played side by side, see AcidComposer::tracks
+
+	ComposerBank() {
+		for (int i = 0; i < PATTERNS; ++i) {
+			lengths[i] = ComposerPattern::MAX_STEPS;
+		}
+	}
+
+	void store(int index, const ComposerPattern& pattern) {
+		for (int i = 0; i < ComposerPattern::MAX_STEPS; ++i) {
+			const ComposerStep& step = pattern.program[i];
+			cv[index][i] = step.cv;
+			steps[index][i] = (step.gate & GATE_MASK) | (step.latch ? LATCH : 0) | (step.accent ? ACCENT : 0) | (step.slide ? SLIDE : 0);
+		}
+		lengths[index] = pattern.length;
+	}
+};
\ No newline at end of file
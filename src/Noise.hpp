@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <slime/Math.hpp>
+
+// Four independent xorshift32 generators, one per lane. A few integer SIMD instructions
+// per call, and the sequence only depends on the seed so renders can be reproduced.
+struct NoiseSimd {
+	__m128i state = _mm_set1_epi32(1);
+
+	// splitmix32 spreads consecutive seeds over the state space, lanes get distinct streams
+	static uint32_t mix(uint32_t x) {
+		x += 0x9e3779b9u;
+		x = (x ^ (x >> 16)) * 0x85ebca6bu;
+		x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+		x = x ^ (x >> 16);
+		// xorshift must never be seeded with zero
+		return x ? x : 1u;
+	}
+
+	void seed(uint32_t seed) {
+		state = _mm_setr_epi32(mix(seed * 4 + 0), mix(seed * 4 + 1), mix(seed * 4 + 2), mix(seed * 4 + 3));
+	}
+
+	// Uniform in [-1, 1)
+	slime::math::float_simd process() {
+		__m128i x = state;
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+		state = x;
+
+		// The top 23 bits become the mantissa of a float in [2, 4)
+		__m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x40000000));
+		return slime::math::float_simd(_mm_castsi128_ps(bits)) - 3.0f;
+	}
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include <array>
+#include <cmath>
+
+// Polyphase half-band FIR resamplers. The prototype lowpass has 4 * M - 1 taps and is centered
+// on an odd tap, so every other tap is zero except the center one (0.5). Each polyphase branch
+// then needs 2 * M multiplies, and the other branch is a plain delay.
+template <int M>
+struct HalfBandCoefficients {
+	static constexpr int TAPS = 2 * M; // non-zero taps besides the center
+	static constexpr int DELAY = M - 1; // position of the center tap in the upsampler delay branch
+
+	std::array<float, TAPS> taps;
+
+	HalfBandCoefficients() {
+		const int length = 4 * M - 1;
+		const int center = 2 * M - 1;
+		const double beta = 8.0; // Kaiser window, about 80dB of stopband rejection
+
+		double sum = 0.0;
+		for (int j = 0; j < TAPS; j++) {
+			int k = 2 * j;
+			double x = 0.5 * (k - center);
+			double sinc = std::sin(M_PI * x) / (M_PI * x);
+			double r = 2.0 * k / (length - 1) - 1.0;
+			double window = besselI0(beta * std::sqrt(1.0 - r * r)) / besselI0(beta);
+			taps[j] = 0.5 * sinc * window;
+			sum += taps[j];
+		}
+
+		// The branch has to sum to 0.5 exactly to keep unity gain at DC
+		for (int j = 0; j < TAPS; j++) {
+			taps[j] *= 0.5 / sum;
+		}
+	}
+
+	static double besselI0(double x) {
+		double sum = 1.0;
+		double term = 1.0;
+		for (int i = 1; i < 32; i++) {
+			term *= (x / (2.0 * i)) * (x / (2.0 * i));
+			sum += term;
+		}
+		return sum;
+	}
+
+	static const HalfBandCoefficients& get() {
+		static const HalfBandCoefficients coefficients;
+		return coefficients;
+	}
+};
+
+// Delay line stored twice so that the last TAPS samples are always contiguous
+template <typename T, int TAPS>
+struct HalfBandHistory {
+	std::array<T, 2 * TAPS> buffer;
+	int pos = 0;
+
+	void reset() {
+		buffer.fill(T(0.0f));
+		pos = 0;
+	}
+
+	// After a push, at(0) is the newest sample and at(TAPS - 1) the oldest
+	void push(T x) {
+		pos = (pos == 0) ? TAPS - 1 : pos - 1;
+		buffer[pos] = x;
+		buffer[pos + TAPS] = x;
+	}
+
+	const T& at(int i) const {
+		return buffer[pos + i];
+	}
+};
+
+template <typename T, int M>
+struct Upsampler2x {
+	using Coefficients = HalfBandCoefficients<M>;
+	HalfBandHistory<T, Coefficients::TAPS> history;
+
+	void reset() {
+		history.reset();
+	}
+
+	// Writes two output samples for each input sample. Forced inline like
+	// Oversampler::upsample.
+	__attribute__((always_inline)) void process(T x, T* out) {
+		const auto& h = Coefficients::get().taps;
+		history.push(x);
+
+		T sum = 0.0f;
+		for (int j = 0; j < Coefficients::TAPS; j++) {
+			sum += h[j] * history.at(j);
+		}
+		out[0] = 2.0f * sum;
+		out[1] = history.at(Coefficients::DELAY);
+	}
+};
+
+template <typename T, int M>
+struct Downsampler2x {
+	using Coefficients = HalfBandCoefficients<M>;
+	HalfBandHistory<T, Coefficients::TAPS> odd;
+	HalfBandHistory<T, Coefficients::TAPS> even;
+
+	void reset() {
+		odd.reset();
+		even.reset();
+	}
+
+	// Reads two input samples for each output sample
+	T process(const T* in) {
+		const auto& h = Coefficients::get().taps;
+		even.push(in[0]);
+		odd.push(in[1]);
+
+		T sum = 0.5f * odd.at(M);
+		for (int j = 0; j < Coefficients::TAPS; j++) {
+			sum += h[j] * even.at(j);
+		}
+		return sum;
+	}
+};
+
+// Cascade of up to three 2x stages. The first stage sees the full band and gets the long
+// filter, the later ones only need to reject images far above the audio band.
+template <typename T>
+struct Oversampler {
+	static constexpr int MAX_FACTOR = 8;
+
+	Upsampler2x<T, 12> up1;
+	Upsampler2x<T, 6> up2, up3;
+	Downsampler2x<T, 12> down1;
+	Downsampler2x<T, 6> down2, down3;
+	int factor = 1;
+
+	void reset() {
+		up1.reset();
+		up2.reset();
+		up3.reset();
+		down1.reset();
+		down2.reset();
+		down3.reset();
+	}
+
+	void setFactor(int new_factor) {
+		if (new_factor != factor) {
+			factor = new_factor;
+			reset();
+		}
+	}
+
+	// The downsamplers alone, which are back to this state anyway after a few dozen frames of zeros
+	void resetDownsampling() {
+		down1.reset();
+		down2.reset();
+		down3.reset();
+	}
+
+	// Writes `factor` samples. Forced inline: called from several variants of the voice
+	// loop, the compiler would otherwise keep it out of line, and the call costs the loop
+	// its registers every frame.
+	__attribute__((always_inline)) void upsample(T x, T* out) {
+		if (factor == 1) {
+			out[0] = x;
+			return;
+		}
+
+		T stage1[2], stage2[4];
+		up1.process(x, factor == 2 ? out : stage1);
+		if (factor == 2)
+			return;
+
+		for (int i = 0; i < 2; i++)
+			up2.process(stage1[i], factor == 4 ? out + 2 * i : stage2 + 2 * i);
+		if (factor == 4)
+			return;
+
+		for (int i = 0; i < 4; i++)
+			up3.process(stage2[i], out + 2 * i);
+	}
+
+	// Reads `factor` samples, `in` is used as scratch space
+	T downsample(T* in) {
+		if (factor == 8) {
+			for (int i = 0; i < 4; i++)
+				in[i] = down3.process(in + 2 * i);
+		}
+		if (factor >= 4) {
+			for (int i = 0; i < 2; i++)
+				in[i] = down2.process(in + 2 * i);
+		}
+		if (factor >= 2) {
+			return down1.process(in);
+		}
+		return in[0];
+	}
+};
@@ -0,0 +1,96 @@
+#include "PatternIndex.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+PatternSignature PatternSignature::of(const PatternRecord& record) {
+	PatternSignature signature;
+	int length = std::max(1, std::min((int)record.length, (int)ComposerPattern::MAX_STEPS));
+	uint64_t gates = 0, ties = 0, accents = 0, slides = 0;
+	uint64_t ups = 0, downs = 0, leaps = 0, pitches = 0;
+	int first = 0;
+	int previous = 0;
+	bool started = false;
+	for (int i = 0; i < ComposerPattern::MAX_STEPS; i++) {
+		int step = i % length;
+		uint64_t bits = record.attributes >> (step * 4);
+		uint64_t mask = 1ull << i;
+		if (bits & PatternRecord::GATE)
+			gates |= mask;
+		if (bits & PatternRecord::TIE)
+			ties |= mask;
+		if (bits & PatternRecord::ACCENT)
+			accents |= mask;
+		if (bits & PatternRecord::SLIDE)
+			slides |= mask;
+		if (!(bits & PatternRecord::GATE))
+			continue;
+
+		// An empty note column plays a C
+		int note = (record.notes[step] == PatternRecord::NO_NOTE) ? 0 : record.notes[step];
+		if (!started) {
+			first = note;
+			started = true;
+		} else {
+			if (note > previous)
+				ups |= mask;
+			if (note < previous)
+				downs |= mask;
+			if (std::abs(note - previous) > 2)
+				leaps |= mask;
+		}
+		pitches |= 1ull << (((note - first) % 12 + 12) % 12);
+		previous = note;
+	}
+	signature.rhythm = gates | (ties << 16) | (accents << 32) | (slides << 48);
+	signature.melody = ups | (downs << 16) | (leaps << 32) | (pitches << 48);
+	return signature;
+}
+
+void PatternIndex::build(const PatternLibrary& library) {
+	if (isBuilt(library))
+		return;
+	generation = library.generation;
+	rhythms.resize(library.count);
+	melodies.resize(library.count);
+	for (int i = 0; i < library.count; i++) {
+		PatternSignature signature = PatternSignature::of(library.record(i));
+		rhythms[i] = signature.rhythm;
+		melodies[i] = signature.melody;
+	}
+}
+
+std::vector<PatternIndex::Match> PatternIndex::findSimilar(const PatternSignature& query, int count) const {
+	// Distances are small integers, so the closest patterns are found with a histogram
+	// rather than by sorting the whole library
+	int size = (int)rhythms.size();
+	std::vector<uint8_t> distances(size);
+	int histogram[PatternSignature::MAX_DISTANCE + 1] = {};
+	for (int i = 0; i < size; i++) {
+		int d = __builtin_popcountll(rhythms[i] ^ query.rhythm) + __builtin_popcountll(melodies[i] ^ query.melody);
+		distances[i] = d;
+		histogram[d]++;
+	}
+
+	count = std::min(count, size);
+	int threshold = 0;
+	for (int found = 0; threshold <= PatternSignature::MAX_DISTANCE; threshold++) {
+		found += histogram[threshold];
+		if (found >= count)
+			break;
+	}
+	std::vector<Match> matches;
+	matches.reserve(count);
+	for (int i = 0; i < size && (int)matches.size() < count; i++) {
+		if (distances[i] < threshold)
+			matches.push_back({i, distances[i]});
+	}
+	for (int i = 0; i < size && (int)matches.size() < count; i++) {
+		if (distances[i] == threshold)
+			matches.push_back({i, distances[i]});
+	}
+	std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+		return a.distance < b.distance || (a.distance == b.distance && a.index < b.index);
+	});
+	return matches;
+}
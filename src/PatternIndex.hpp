@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "PatternLibrary.hpp"
+
+// What a pattern sounds like, packed in two words so that patterns are compared by counting
+// the bits that differ. Patterns are read as they play over 16 steps, shorter ones repeating,
+// so a pattern and its half length version look the same.
+struct PatternSignature {
+	static constexpr int MAX_DISTANCE = 128;
+
+	uint64_t rhythm = 0; // gate, tie, accent and slide masks, 16 bits each
+	// Whether each note goes up, down, or leaps more than a tone from the previous one, 16
+	// bits each, and the pitch classes used relative to the first note, so transposing a
+	// pattern doesn't change it
+	uint64_t melody = 0;
+
+	static PatternSignature of(const PatternRecord& record);
+};
+
+// Signatures of every pattern of a library, as two flat arrays that a query scans in order.
+// Distances are the number of differing bits, counted with the popcnt instruction that is
+// part of the nehalem baseline Rack is built for.
+struct PatternIndex {
+	// PatternLibrary::generation this was built from
+	uint64_t generation = 0;
+	std::vector<uint64_t> rhythms;
+	std::vector<uint64_t> melodies;
+
+	// Only rebuilds if the library changed
+	void build(const PatternLibrary& library);
+
+	bool isBuilt(const PatternLibrary& library) const {
+		return generation == library.generation;
+	}
+
+	struct Match {
+		int index;
+		int distance;
+	};
+
+	// The `count` patterns closest to `query`, closest first
+	std::vector<Match> findSimilar(const PatternSignature& query, int count) const;
+};
@@ -0,0 +1,234 @@
+#include "PatternLibrary.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <rack.hpp>
+
+#if defined ARCH_WIN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+static const char MAGIC[8] = "TAKPLIB";
+
+// Shared by all libraries, so that no two states of any library get the same generation
+static uint64_t last_generation = 0;
+
+bool PatternLibrary::open(const std::string& path) {
+	close();
+#if defined ARCH_WIN
+	HANDLE file = CreateFileW(rack::string::UTF8toUTF16(path).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(PatternLibraryHeader)) {
+		CloseHandle(file);
+		return false;
+	}
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		close();
+		return false;
+	}
+	size = (size_t)file_size.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PatternLibraryHeader)) {
+		::close(fd);
+		return false;
+	}
+	void* mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+	data = mapped;
+	size = (size_t)st.st_size;
+#endif
+
+	const PatternLibraryHeader* header = (const PatternLibraryHeader*)data;
+	if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != PatternLibraryHeader::VERSION
+		|| header->record_size != sizeof(PatternRecord)
+		|| header->count > (size - sizeof(PatternLibraryHeader)) / sizeof(PatternRecord)) {
+		close();
+		return false;
+	}
+	records = (const PatternRecord*)(header + 1);
+	count = (int)header->count;
+	this->path = path;
+	generation = ++last_generation;
+	return true;
+}
+
+void PatternLibrary::close() {
+#if defined ARCH_WIN
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+#else
+	if (data)
+		munmap(data, size);
+#endif
+	data = nullptr;
+	mapping = nullptr;
+	size = 0;
+	records = nullptr;
+	count = 0;
+	path.clear();
+	generation = ++last_generation;
+}
+
+PatternRecord encodePattern(const ChartLine* chart, const ComposerPattern& pattern, const std::string& name) {
+	PatternRecord record;
+	std::memset(&record, 0, sizeof(record));
+	std::strncpy(record.name, name.c_str(), PatternRecord::NAME_SIZE - 1);
+	record.letter = pattern.letter;
+	record.length = pattern.length;
+	record.transpose = (int8_t)std::round(pattern.transpose * 12.0f);
+
+	const ChartLine& notes = chart[PatternParseResult::NOTES];
+	const ChartLine& octave = chart[PatternParseResult::OCTAVE];
+	for (int step = 0; step < ComposerPattern::MAX_STEPS; ++step) {
+		const StepAttributes& attributes = pattern.attributes[step];
+		uint64_t bits = (attributes.getGate() ? PatternRecord::GATE : 0) | (attributes.getAccent() ? PatternRecord::ACCENT : 0)
+			| (attributes.getSlide() ? PatternRecord::SLIDE : 0) | (attributes.getTie() ? PatternRecord::TIE : 0);
+		record.attributes |= bits << (step * 4);
+
+		bool empty = notes.at(step * 2) == ' ' && notes.at(step * 2 + 1) == ' ' && octave.at(step) == ' ';
+		record.notes[step] = (step >= pattern.length || empty) ? PatternRecord::NO_NOTE : (int8_t)std::round(pattern.notes[step] * 12.0f);
+	}
+	return record;
+}
+
+void decodePattern(const PatternRecord& record, char letter, std::string* chart) {
+	static const char* NAMES[] = {"cb", "c ", "c#", "d ", "d#", "e ", "f ", "f#", "g ", "g#", "a ", "a#", "b ", "b#"};
+
+	char header[16];
+	std::snprintf(header, sizeof(header), "%c %d %+d", letter, record.length, record.transpose);
+	chart[PatternParseResult::HEADER] = header;
+	std::string& notes = chart[PatternParseResult::NOTES] = std::string(2 * ComposerPattern::MAX_STEPS, ' ');
+	std::string& octave = chart[PatternParseResult::OCTAVE] = std::string(ComposerPattern::MAX_STEPS, ' ');
+	std::string& slide_accent = chart[PatternParseResult::SLIDE_ACCENT] = std::string(2 * ComposerPattern::MAX_STEPS, ' ');
+	std::string& time = chart[PatternParseResult::TIME] = std::string(ComposerPattern::MAX_STEPS, ' ');
+
+	for (int step = 0; step < record.length && step < ComposerPattern::MAX_STEPS; ++step) {
+		int note = record.notes[step];
+		if (note != PatternRecord::NO_NOTE) {
+			// Charts reach from cb an octave down to b# an octave up
+			int shift = (note < 0) ? -1 : (note >= 12) ? 1 : 0;
+			int semitone = rack::math::clamp(note - shift * 12, -1, 12);
+			notes[step * 2] = NAMES[semitone + 1][0];
+			notes[step * 2 + 1] = NAMES[semitone + 1][1];
+			octave[step] = (shift < 0) ? 'D' : (shift > 0) ? 'U' : ' ';
+		}
+
+		uint64_t bits = record.attributes >> (step * 4);
+		if (bits & PatternRecord::ACCENT) {
+			slide_accent[step * 2] = 'A';
+			slide_accent[step * 2 + 1] = (bits & PatternRecord::SLIDE) ? 'S' : ' ';
+		} else if (bits & PatternRecord::SLIDE) {
+			slide_accent[step * 2] = 'S';
+		}
+		time[step] = (bits & PatternRecord::TIE) ? '_' : (bits & PatternRecord::GATE) ? 'o' : ' ';
+	}
+}
+
+bool writePatternLibrary(const std::string& path, const PatternRecord* records, int count) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	PatternLibraryHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = PatternLibraryHeader::VERSION;
+	header.record_size = sizeof(PatternRecord);
+	header.count = count;
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)records, (std::streamsize)count * sizeof(PatternRecord));
+	return (bool)file;
+}
+
+bool importCharts(const std::string& chart_path, const std::string& library_path, ChartImportResult* result) {
+	*result = ChartImportResult();
+	std::ifstream file(chart_path, std::ios::binary);
+	if (!file) {
+		result->message = "can't open " + chart_path;
+		return false;
+	}
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(file, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		lines.push_back(line);
+	}
+
+	auto problem = [&](int line, const std::string& message) {
+		if (result->message.empty()) {
+			result->line = line + 1;
+			result->message = message;
+		}
+	};
+
+	std::vector<PatternRecord> records;
+	std::string name;
+	std::string stem = rack::system::getStem(chart_path);
+	for (size_t i = 0; i < lines.size(); i++) {
+		const std::string& l = lines[i];
+		if (l.empty() || l.find_first_not_of(" \t") == std::string::npos)
+			continue;
+		if (l[0] == '#') {
+			size_t start = l.find_first_not_of("# \t");
+			name = (start == std::string::npos) ? "" : l.substr(start);
+			continue;
+		}
+		ChartLine chart[PatternParseResult::LINES_LEN] = {{"", 0}, {"", 0}, {"", 0}, {"", 0}, {"", 0}};
+		for (int c = 0; c < PatternParseResult::LINES_LEN && i + c < lines.size(); c++)
+			chart[c] = lines[i + c];
+		ComposerPattern pattern;
+		PatternParseResult parsed = parsePattern(chart[0], chart[1], chart[2], chart[3], chart[4], &pattern);
+		// Without a letter, a space and a length the line doesn't start a chart, the parser
+		// decides so that the import reads headers exactly as the Composer does
+		if (parsed.error == PatternParseResult::INVALID_LETTER || parsed.error == PatternParseResult::MISSING_SPACE
+			|| parsed.error == PatternParseResult::MISSING_LENGTH) {
+			problem(i, "line is not part of a chart");
+			result->skipped++;
+			continue;
+		}
+		if (parsed.error != PatternParseResult::OK)
+			problem(i + parsed.line, parsed.message());
+		// The line starts like a header, only a length out of range keeps it from being used
+		if (parsed.error == PatternParseResult::INVALID_LENGTH) {
+			result->skipped++;
+		} else {
+			if (name.empty())
+				name = stem + " " + std::to_string(records.size() + 1);
+			records.push_back(encodePattern(chart, pattern, name));
+			result->imported++;
+		}
+		name.clear();
+		i += PatternParseResult::LINES_LEN - 1;
+	}
+
+	if (!writePatternLibrary(library_path, records.data(), (int)records.size())) {
+		result->message = "can't write " + library_path;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "PatternParser.hpp"
+
+// Binary pattern library. A file is a header followed by fixed size records, so pattern i
+// is at a known offset and the record array is its own index: opening a library only maps
+// the file and checks the header, whatever the number of patterns. Records are one cache
+// line each, stored little endian like every platform Rack runs on.
+struct PatternRecord {
+	static constexpr int NAME_SIZE = 32;
+	static constexpr int8_t NO_NOTE = -128; // empty note column
+	// Step attributes, four bits per step
+	static constexpr uint64_t GATE = 0x1;
+	static constexpr uint64_t ACCENT = 0x2;
+	static constexpr uint64_t SLIDE = 0x4;
+	static constexpr uint64_t TIE = 0x8;
+
+	char name[NAME_SIZE]; // nul terminated
+	uint64_t attributes;
+	int8_t notes[ComposerPattern::MAX_STEPS]; // semitones from C, octave included
+	char letter;
+	uint8_t length;
+	int8_t transpose; // semitones
+	uint8_t reserved[5];
+};
+static_assert(sizeof(PatternRecord) == 64, "pattern records are one cache line");
+
+struct PatternLibraryHeader {
+	static constexpr uint32_t VERSION = 1;
+
+	char magic[8]; // "TAKPLIB", nul terminated
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t count;
+	uint8_t reserved[44];
+};
+static_assert(sizeof(PatternLibraryHeader) == 64, "records stay aligned to cache lines");
+
+// A library file mapped read only. Only used from the UI thread.
+struct PatternLibrary {
+	std::string path;
+	const PatternRecord* records = nullptr;
+	int count = 0;
+	void* data = nullptr;
+	size_t size = 0;
+	void* mapping = nullptr; // file mapping handle on Windows
+	// New on every open() and close(). A file rewritten in place can map at the same address
+	// with the same count, so anything built from the records compares this instead.
+	uint64_t generation = 0;
+
+	PatternLibrary() {}
+	PatternLibrary(const PatternLibrary&) = delete;
+	PatternLibrary& operator=(const PatternLibrary&) = delete;
+	~PatternLibrary() {
+		close();
+	}
+
+	// Returns false, leaving the library closed, if the file can't be mapped or isn't a library
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const {
+		return records != nullptr;
+	}
+
+	const PatternRecord& record(int index) const {
+		return records[index];
+	}
+};
+
+// Packs a pattern parsed from `chart`, which is needed to tell empty note columns from C
+PatternRecord encodePattern(const ChartLine* chart, const ComposerPattern& pattern, const std::string& name);
+
+// Writes the chart lines of a record back, with `letter` in the header. Notes are spelled
+// with sharps, so the chart may differ from the imported one but plays the same pattern.
+void decodePattern(const PatternRecord& record, char letter, std::string* chart);
+
+bool writePatternLibrary(const std::string& path, const PatternRecord* records, int count);
+
+struct ChartImportResult {
+	int imported = 0;
+	int skipped = 0; // charts without a valid header and lines that aren't part of a chart
+	// The first problem found, with its line in the chart file
+	int line = 0;
+	std::string message;
+};
+
+// Imports a text file of charts into a library. Each chart is a header line followed by
+// its four other lines, charts can be separated by empty lines and a line starting with #
+// names the next chart. Charts with errors after the header are imported the way they
+// play. Returns false if either file can't be opened.
+bool importCharts(const std::string& chart_path, const std::string& library_path, ChartImportResult* result);
@@ -0,0 +1,268 @@
+#include "PatternParser.hpp"
+
+#include <cstring>
+
+static inline bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// Note letter to CV, in V from C
+static inline bool noteToCv(char c, float* cv) {
+	switch (c) {
+		case 'c': case 'C': *cv = 0.0; return true;
+		case 'd': case 'D': *cv = 2.0 / 12.0; return true;
+		case 'e': case 'E': *cv = 4.0 / 12.0; return true;
+		case 'f': case 'F': *cv = 5.0 / 12.0; return true;
+		case 'g': case 'G': *cv = 7.0 / 12.0; return true;
+		case 'a': case 'A': *cv = 9.0 / 12.0; return true;
+		case 'b': case 'B': *cv = 11.0 / 12.0; return true;
+		default: return false;
+	}
+}
+
+const char* PatternParseResult::message() const {
+	switch (error) {
+		case OK: return "ok";
+		case INVALID_LETTER: return "pattern letter must be A to Z";
+		case MISSING_SPACE: return "expected a space after the pattern letter";
+		case MISSING_LENGTH: return "expected the pattern length";
+		case INVALID_LENGTH: return "pattern length must be 1 to 16";
+		case INVALID_TRANSPOSE: return "transpose must be + or - and one or two digits";
+		case UNEXPECTED_CHARACTER: return "unexpected character after the header";
+		case INVALID_NOTE: return "invalid note";
+		case INVALID_OCTAVE: return "octave must be U, D or a space";
+		case INVALID_SLIDE_ACCENT: return "slide/accent must be S, A or a space";
+		case INVALID_TIME: return "time must be o, _, - or a space";
+		default: return "unknown error";
+	}
+}
+
+struct Header {
+	char letter;
+	int length;
+	int transpose;
+};
+
+// Header grammar: letter, spaces, length, optional spaces, optional [+-] and one or two
+// digits, optional trailing spaces. Several transposes in a row are accepted, the last
+// one wins. Errors after the length are reported but the header is still used.
+static bool parseHeader(ChartLine line, Header* header, PatternParseResult* result) {
+	auto fail = [&](PatternParseResult::Error error, int column) {
+		result->error = error;
+		result->line = PatternParseResult::HEADER;
+		result->column = column;
+		return false;
+	};
+
+	header->transpose = 0;
+
+	int i = 0;
+	char letter = line.at(i);
+	if (i >= line.size || letter < 'A' || letter > 'Z')
+		return fail(PatternParseResult::INVALID_LETTER, i);
+	i++;
+
+	if (i >= line.size || !isSpace(line.at(i)))
+		return fail(PatternParseResult::MISSING_SPACE, i);
+	while (i < line.size && isSpace(line.at(i)))
+		i++;
+
+	if (i >= line.size || !isDigit(line.at(i)))
+		return fail(PatternParseResult::MISSING_LENGTH, i);
+	int length_column = i;
+	int length = 0;
+	while (i < line.size && isDigit(line.at(i))) {
+		// Saturate, anything this long is out of range anyway
+		if (length < 1000)
+			length = length * 10 + (line.at(i) - '0');
+		i++;
+	}
+	if (length < 1 || length > ComposerPattern::MAX_STEPS)
+		return fail(PatternParseResult::INVALID_LENGTH, length_column);
+
+	header->letter = letter;
+	header->length = length;
+
+	while (i < line.size) {
+		char c = line.at(i);
+		if (isSpace(c)) {
+			i++;
+		} else if (c == '+' || c == '-') {
+			int sign_column = i;
+			i++;
+			if (i >= line.size || !isDigit(line.at(i))) {
+				fail(PatternParseResult::INVALID_TRANSPOSE, sign_column);
+				break;
+			}
+			int value = line.at(i++) - '0';
+			if (i < line.size && isDigit(line.at(i)))
+				value = value * 10 + (line.at(i++) - '0');
+			header->transpose = (c == '-') ? -value : value;
+			if (i < line.size && isDigit(line.at(i))) {
+				fail(PatternParseResult::INVALID_TRANSPOSE, sign_column);
+				break;
+			}
+		} else {
+			fail(PatternParseResult::UNEXPECTED_CHARACTER, i);
+			break;
+		}
+	}
+	return true;
+}
+
+PatternParseResult parsePattern(ChartLine header_line, ChartLine notes, ChartLine octave, ChartLine slide_accent,
+								ChartLine time, ComposerPattern* pattern, uint32_t steps) {
+	PatternParseResult result;
+	if (steps == ComposerPattern::ALL_STEPS)
+		*pattern = ComposerPattern();
+
+	Header header;
+	if (!parseHeader(header_line, &header, &result)) {
+		*pattern = ComposerPattern();
+		compileProgram(pattern);
+		return result;
+	}
+
+	auto error = [&](PatternParseResult::Error error, PatternParseResult::Line line, int column) {
+		if (result.error == PatternParseResult::OK) {
+			result.error = error;
+			result.line = line;
+			result.column = column;
+		}
+	};
+
+	for (int step = 0; step < ComposerPattern::MAX_STEPS; ++step) {
+		if (!(steps & (1u << step)))
+			continue;
+		if (step >= header.length) {
+			pattern->notes[step] = 0.0f;
+			pattern->attributes[step].clear();
+			continue;
+		}
+		float cv = 0.0f;
+
+		// Notes, two columns per step: letter then # or b
+		char note = notes.at(step * 2);
+		char accidental = notes.at(step * 2 + 1);
+		if (note != ' ') {
+			if (!noteToCv(note, &cv)) {
+				error(PatternParseResult::INVALID_NOTE, PatternParseResult::NOTES, step * 2);
+			}
+			if (accidental == '#') { cv += ComposerPattern::SEMITONE; }
+			if (accidental == 'b') { cv -= ComposerPattern::SEMITONE; }
+		}
+		// Any note letter is accepted in the second column, like in the editor
+		float unused;
+		if (accidental != ' ' && accidental != '#' && !noteToCv(accidental, &unused)) {
+			error(PatternParseResult::INVALID_NOTE, PatternParseResult::NOTES, step * 2 + 1);
+		}
+
+		// Octave
+		char ud = octave.at(step);
+		float shift = 0.0f;
+		if (ud == 'U' || ud == 'u') { shift = 1.0; }
+		else if (ud == 'D' || ud == 'd') { shift = -1.0; }
+		else if (ud != ' ') { error(PatternParseResult::INVALID_OCTAVE, PatternParseResult::OCTAVE, step); }
+		pattern->notes[step] = cv + shift;
+
+		// Slide and accent, two columns per step, only read when the first one isn't empty
+		StepAttributes& attributes = pattern->attributes[step];
+		attributes.clear();
+		char first = slide_accent.at(step * 2);
+		char second = slide_accent.at(step * 2 + 1);
+		for (int column = 0; column < 2; column++) {
+			char c = column ? second : first;
+			if (c != ' ' && c != 'S' && c != 's' && c != 'A' && c != 'a')
+				error(PatternParseResult::INVALID_SLIDE_ACCENT, PatternParseResult::SLIDE_ACCENT, step * 2 + column);
+		}
+		if (first != ' ') {
+			if (first == 'S' || first == 's' || second == 'S' || second == 's') { attributes.setSlide(true); }
+			if (first == 'A' || first == 'a' || second == 'A' || second == 'a') { attributes.setAccent(true); }
+		}
+
+		// Time
+		char t = time.at(step);
+		if (t == 'O' || t == 'o') { attributes.setGate(true); }
+		else if (t == '_') { attributes.setTie(true); }
+		else if (t == ' ' || t == '-') { attributes.clear(); } // Rest
+		else {
+			attributes.clear();
+			error(PatternParseResult::INVALID_TIME, PatternParseResult::TIME, step);
+		}
+	}
+
+	pattern->letter = header.letter;
+	pattern->length = header.length;
+	pattern->transpose = header.transpose * ComposerPattern::SEMITONE;
+	compileProgram(pattern, steps);
+	return result;
+}
+
+uint32_t changedSteps(const ChartLine* before, const ChartLine* after) {
+	const ChartLine& header = before[PatternParseResult::HEADER];
+	const ChartLine& new_header = after[PatternParseResult::HEADER];
+	if (header.size != new_header.size || std::memcmp(header.text, new_header.text, header.size) != 0)
+		return ComposerPattern::ALL_STEPS;
+
+	uint32_t steps = 0;
+	for (int line = PatternParseResult::NOTES; line < PatternParseResult::LINES_LEN; line++) {
+		// Notes and slide/accent take two columns per step
+		int columns = (line == PatternParseResult::NOTES || line == PatternParseResult::SLIDE_ACCENT) ? 2 : 1;
+		for (int i = 0; i < ComposerPattern::MAX_STEPS * columns; i++) {
+			if (before[line].at(i) != after[line].at(i))
+				steps |= 1u << (i / columns);
+		}
+	}
+	return steps;
+}
+
+void compileProgram(ComposerPattern* pattern, uint32_t steps) {
+	// A step's gate depends on the steps around it, the first and last steps are neighbours
+	uint32_t last = 1u << (pattern->length - 1);
+	uint32_t neighbours = (steps << 1) | (steps >> 1);
+	if (steps & 1u)
+		neighbours |= last;
+	if (steps & last)
+		neighbours |= 1u;
+	steps = (steps | neighbours) & ComposerPattern::ALL_STEPS;
+
+	for (int step = 0; step < ComposerPattern::MAX_STEPS; step++) {
+		if (!(steps & (1u << step)))
+			continue;
+		const StepAttributes& current = pattern->attributes[step];
+		const StepAttributes& previous = pattern->attributes[pattern->previousStep(step)];
+		const StepAttributes& next = pattern->attributes[pattern->nextStep(step)];
+
+		bool isGate = current.getGate();
+		bool isTie = current.getTie();
+		bool isSlide = current.getSlide();
+
+		ComposerStep& program = pattern->program[step];
+		program.gate = ComposerStep::GATE_LOW;
+		// stay high: gate with upcoming slide or tie
+		// or: during a long tie or a long slide
+		if ((isGate && (next.getTie() || next.getSlide())) || (isTie && previous.getTie() && next.getTie())
+			|| (isSlide && previous.getSlide() && next.getSlide())) {
+			program.gate = ComposerStep::GATE_HIGH;
+		}
+		// copy clock: normal gate, no upcoming slide or tie
+		// or: end of a tie
+		else if ((isGate && (!next.getTie() || !next.getSlide())) || (isTie && previous.getTie() && !next.getTie())) {
+			program.gate = ComposerStep::GATE_FOLLOW;
+		}
+		if (isTie && previous.getGate()) {
+			// during the first tie after a gate, copy clock if it's just a 2 steps tie, or stay high if more tie upcoming
+			program.gate = (next.getTie() || next.getSlide()) ? ComposerStep::GATE_HIGH : ComposerStep::GATE_FOLLOW;
+		}
+
+		// cv, accent and slide are latched to the gate
+		program.latch = isGate;
+		program.cv = pattern->notes[step] + pattern->transpose;
+		program.accent = current.getAccent();
+		program.slide = isSlide;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+
+#include "ComposerPattern.hpp"
+
+// One line of a pattern chart. Reading past the end gives a space, so short lines are
+// simply padded with rests.
+struct ChartLine {
+	const char* text;
+	int size;
+
+	ChartLine(const char* text, int size) : text(text), size(size) {}
+	ChartLine(const std::string& line) : text(line.data()), size((int)line.size()) {}
+
+	char at(int i) const {
+		return (i >= 0 && i < size) ? text[i] : ' ';
+	}
+};
+
+struct PatternParseResult {
+	enum Error {
+		OK,
+		INVALID_LETTER,
+		MISSING_SPACE,
+		MISSING_LENGTH,
+		INVALID_LENGTH,
+		INVALID_TRANSPOSE,
+		UNEXPECTED_CHARACTER,
+		INVALID_NOTE,
+		INVALID_OCTAVE,
+		INVALID_SLIDE_ACCENT,
+		INVALID_TIME,
+		ERRORS_LEN
+	};
+	enum Line {
+		HEADER,
+		NOTES,
+		OCTAVE,
+		SLIDE_ACCENT,
+		TIME,
+		LINES_LEN
+	};
+
+	// The first error found, with its position in the chart
+	Error error = OK;
+	Line line = HEADER;
+	int column = 0;
+
+	const char* message() const;
+};
+
+// Compiles the five lines of a chart into `pattern` in a single pass, without allocating
+// or throwing. Header errors leave an empty pattern. Other errors are reported but the
+// offending character is read as a rest, so the rest of the pattern still plays.
+// With a mask of `steps`, only those steps are parsed again and the others are kept from
+// `pattern`, which must then have been compiled from a chart with the same header.
+PatternParseResult parsePattern(ChartLine header, ChartLine notes, ChartLine octave, ChartLine slide_accent,
+								ChartLine time, ComposerPattern* pattern,
+								uint32_t steps = ComposerPattern::ALL_STEPS);
+
+// Mask of the steps whose characters differ between two charts of LINES_LEN lines,
+// every step if the header changed
+uint32_t changedSteps(const ChartLine* before, const ChartLine* after);
+
+// Works out the program of the `steps` in the mask and of their neighbours, which depend on them
+void compileProgram(ComposerPattern* pattern, uint32_t steps = ComposerPattern::ALL_STEPS);
@@ -0,0 +1,212 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include <rack.hpp>
+
+#if defined TAK_PROFILE && (defined __x86_64__ || defined __i386__)
+	#include <x86intrin.h>
+#endif
+
+// Per stage timing of the DSP, compiled in with `make TAK_PROFILE=1` and shown in the
+// module context menus, or copied from there as JSON. Without TAK_PROFILE the clock and profile below are empty and
+// their calls compile away to nothing.
+//
+// Each stage is written by a single thread, so the counters are plain relaxed loads and
+// stores that the UI thread can read at any time without locking anything.
+
+#ifdef TAK_PROFILE
+
+// Time stamp counter on x86, converted to nanoseconds against the steady clock over the
+// lifetime of the profile, the steady clock itself elsewhere
+struct ProfileClock {
+	uint64_t last = now();
+
+	static uint64_t now() {
+#if defined __x86_64__ || defined __i386__
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Ticks since the last lap
+	uint64_t lap() {
+		uint64_t t = now();
+		uint64_t ticks = t - last;
+		last = t;
+		return ticks;
+	}
+};
+
+struct ProfileStage {
+	// Ticks per sample of each call, four buckets per octave
+	static constexpr int BUCKETS = 80;
+
+	std::atomic<uint64_t> calls{0};
+	std::atomic<uint64_t> samples{0};
+	std::atomic<uint64_t> ticks{0};
+	std::atomic<uint32_t> buckets[BUCKETS];
+
+	ProfileStage() {
+		for (auto& bucket : buckets)
+			bucket.store(0, std::memory_order_relaxed);
+	}
+
+	static int bucket(uint64_t ticks) {
+		if (ticks < 4)
+			return (int)ticks;
+		int octave = 63 - __builtin_clzll(ticks);
+		int b = octave * 4 + (int)((ticks >> (octave - 2)) & 3);
+		return (b < BUCKETS) ? b : BUCKETS - 1;
+	}
+
+	// Smallest tick count of the bucket after `b`
+	static double bucketLimit(int b) {
+		if (b < 4)
+			return b + 1;
+		int octave = (b + 1) / 4;
+		return (double)(4 + (b + 1) % 4) * std::ldexp(1.0, octave - 2);
+	}
+
+	void add(uint64_t elapsed, int count) {
+		auto bump = [](std::atomic<uint64_t>& counter, uint64_t value) {
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		};
+		bump(calls, 1);
+		bump(samples, count);
+		bump(ticks, elapsed);
+		std::atomic<uint32_t>& b = buckets[bucket(elapsed / count)];
+		b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+};
+
+// What a stage took since the profile was last cleared
+struct ProfileSummary {
+	uint64_t calls = 0;
+	uint64_t samples = 0;
+	double ns_per_sample = 0.0;
+	double p99 = 0.0; // ns per sample, 99% of the calls were faster
+};
+
+template <int STAGES>
+struct Profile {
+	ProfileStage stages[STAGES];
+	// Counters when the profile was last cleared, only touched by the UI thread
+	uint64_t cleared_calls[STAGES] = {};
+	uint64_t cleared_samples[STAGES] = {};
+	uint64_t cleared_ticks[STAGES] = {};
+	uint32_t cleared_buckets[STAGES][ProfileStage::BUCKETS] = {};
+	// Calibration of the clock against the steady clock
+	uint64_t start_ticks = ProfileClock::now();
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	void add(int stage, uint64_t ticks, int samples) {
+		stages[stage].add(ticks, samples);
+	}
+
+	double nsPerTick() const {
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+		uint64_t ticks = ProfileClock::now() - start_ticks;
+		return (ticks > 0) ? ns / ticks : 0.0;
+	}
+
+	// UI thread
+	ProfileSummary summary(int stage) const {
+		const ProfileStage& s = stages[stage];
+		ProfileSummary result;
+		result.calls = s.calls.load(std::memory_order_relaxed) - cleared_calls[stage];
+		result.samples = s.samples.load(std::memory_order_relaxed) - cleared_samples[stage];
+		if (result.calls == 0 || result.samples == 0)
+			return result;
+		double scale = nsPerTick();
+		result.ns_per_sample = (s.ticks.load(std::memory_order_relaxed) - cleared_ticks[stage]) * scale / result.samples;
+
+		uint64_t counts[ProfileStage::BUCKETS];
+		uint64_t total = 0;
+		for (int b = 0; b < ProfileStage::BUCKETS; b++) {
+			counts[b] = s.buckets[b].load(std::memory_order_relaxed) - cleared_buckets[stage][b];
+			total += counts[b];
+		}
+		uint64_t seen = 0;
+		for (int b = 0; b < ProfileStage::BUCKETS; b++) {
+			seen += counts[b];
+			if (seen * 100 >= total * 99) {
+				result.p99 = ProfileStage::bucketLimit(b) * scale;
+				break;
+			}
+		}
+		return result;
+	}
+
+	// UI thread, the writers never see it
+	void clear() {
+		for (int stage = 0; stage < STAGES; stage++) {
+			const ProfileStage& s = stages[stage];
+			cleared_calls[stage] = s.calls.load(std::memory_order_relaxed);
+			cleared_samples[stage] = s.samples.load(std::memory_order_relaxed);
+			cleared_ticks[stage] = s.ticks.load(std::memory_order_relaxed);
+			for (int b = 0; b < ProfileStage::BUCKETS; b++)
+				cleared_buckets[stage][b] = s.buckets[b].load(std::memory_order_relaxed);
+		}
+	}
+
+	// `unit` is what a sample stands for in the stage
+	std::string label(int stage, const char* name, const char* unit = "sample") const {
+		ProfileSummary s = summary(stage);
+		return rack::string::f("%s: %.1f ns/%s, p99 %.0f ns", name, s.ns_per_sample, unit, s.p99);
+	}
+
+	json_t* toJson(const char* const* names) const {
+		json_t* rootJ = json_object();
+		for (int stage = 0; stage < STAGES; stage++) {
+			ProfileSummary s = summary(stage);
+			json_t* stageJ = json_object();
+			json_object_set_new(stageJ, "calls", json_integer(s.calls));
+			json_object_set_new(stageJ, "samples", json_integer(s.samples));
+			json_object_set_new(stageJ, "nsPerSample", json_real(s.ns_per_sample));
+			json_object_set_new(stageJ, "p99", json_real(s.p99));
+			json_object_set_new(rootJ, names[stage], stageJ);
+		}
+		return rootJ;
+	}
+};
+
+// "Profile" submenu listing every stage, read when it opens. `units` says what a sample
+// stands for in each stage, samples of the audio by default.
+template <int STAGES>
+void appendProfileMenu(rack::ui::Menu* menu, Profile<STAGES>* profile, const char* const* names,
+					   const char* const* units = nullptr) {
+	menu->addChild(rack::createSubmenuItem("Profile", "", [=](rack::ui::Menu* menu) {
+		for (int stage = 0; stage < STAGES; stage++) {
+			menu->addChild(rack::createMenuLabel(profile->label(stage, names[stage], units ? units[stage] : "sample")));
+		}
+		menu->addChild(new rack::ui::MenuSeparator);
+		menu->addChild(rack::createMenuItem("Clear", "", [=]() { profile->clear(); }));
+		menu->addChild(rack::createMenuItem("Copy as JSON", "", [=]() {
+			json_t* rootJ = profile->toJson(names);
+			char* json = json_dumps(rootJ, JSON_INDENT(2));
+			glfwSetClipboardString(APP->window->win, json);
+			free(json);
+			json_decref(rootJ);
+		}));
+	}));
+}
+
+#else
+
+struct ProfileClock {
+	uint64_t lap() {
+		return 0;
+	}
+};
+
+template <int STAGES>
+struct Profile {
+	void add(int, uint64_t, int) {}
+};
+
+#endif
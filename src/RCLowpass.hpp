@@ -0,0 +1,118 @@
+#pragma once
+#include <cmath>
+#include <rack.hpp>
+
+#include "chowdsp_wdf/chowdsp_wdf.h"
+
+// The 303 slide circuit: the pitch CV drives a series resistor and capacitor, and the
+// slid CV is the voltage across the capacitor. The knobs move R and C around their
+// original values of 100k and 0.22u.
+struct RCValues {
+	static double resistance(float rMod) {
+		return 100.0e3 + 99.9e3 * rMod;
+	}
+
+	static double capacitance(float cMod) {
+		return 220e-9 + 219.9e-9 * cMod;
+	}
+};
+
+// Wave digital filter model of the circuit, in any precision. Kept as the reference
+// the one-pole below is checked against.
+template <typename T>
+struct RCLowpassWDF {
+	chowdsp::wdft::ResistorT<T> r1 { 100.0e3 };
+	chowdsp::wdft::CapacitorT<T> c1 { .22e-6 };
+
+	chowdsp::wdft::WDFSeriesT<T, decltype (r1), decltype (c1)> s1 { r1, c1 };
+	chowdsp::wdft::IdealVoltageSourceT<T, decltype (s1)> vSource { s1 };
+
+	T lastSample = 0;
+
+	void setRackParameters(float rMod, float cMod) {
+		r1.setResistanceValue(RCValues::resistance(rMod));
+		c1.setCapacitanceValue(RCValues::capacitance(cMod));
+	}
+
+	void prepare(double sampleRate) {
+		c1.prepare(sampleRate);
+	}
+
+	inline T processSample(T x) {
+		vSource.setVoltage(x);
+
+		vSource.incident(s1.reflected());
+		s1.incident(vSource.reflected());
+
+		lastSample = -1 * chowdsp::wdft::voltage<T>(c1);
+		return lastSample;
+	}
+};
+
+// The same circuit as a one-pole. The WDF capacitor is the bilinear transform, so with
+// g = 1 / (2 R C fs) this matches the model above to rounding, in float and with the
+// coefficients only worked out when R, C or the sample rate change. The state is kept
+// as the capacitor voltage relative to the input, which decays geometrically without
+// losing precision in float, and once it has settled the filter is bypassed.
+// T is float, or float_4 to run four slides at once (only bypassed when all have settled).
+template <typename T>
+struct RCLowpass {
+	static constexpr float CONVERGED = 1e-5f; // V, a hundredth of a cent
+
+	double resistance = RCValues::resistance(0.0f);
+	double capacitance = RCValues::capacitance(0.0f);
+	double sampleRate = 44100.0;
+	T pole = 0.0f; // (1 - g) / (1 + g)
+	T outputGain = 0.0f; // 1 / (1 + g)
+	T input = 0.0f;
+	T deviation = 0.0f; // capacitor state minus input
+	T lastSample = 0.0f;
+
+	RCLowpass() {
+		updateCoefficients();
+	}
+
+	void setRackParameters(float rMod, float cMod) {
+		resistance = RCValues::resistance(rMod);
+		capacitance = RCValues::capacitance(cMod);
+		updateCoefficients();
+	}
+
+	void prepare(double sampleRate) {
+		this->sampleRate = sampleRate;
+		updateCoefficients();
+	}
+
+	void updateCoefficients() {
+		double g = 1.0 / (2.0 * resistance * capacitance * sampleRate);
+		pole = (float)((1.0 - g) / (1.0 + g));
+		outputGain = (float)(1.0 / (1.0 + g));
+	}
+
+	void reset(T x = 0.0f) {
+		input = x;
+		deviation = 0.0f;
+		lastSample = x;
+	}
+
+	static bool settled(float deviation) {
+		return std::fabs(deviation) < CONVERGED;
+	}
+
+	static bool settled(rack::simd::float_4 deviation) {
+		return rack::simd::movemask(rack::simd::fabs(deviation) < CONVERGED) == 0xf;
+	}
+
+	inline T processSample(T x) {
+		deviation += input - x;
+		input = x;
+		if (settled(deviation)) {
+			deviation = 0.0f;
+			lastSample = x;
+			return x;
+		}
+		lastSample = x + deviation * outputGain;
+		deviation *= pole;
+		return lastSample;
+	}
+};
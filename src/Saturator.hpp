@@ -0,0 +1,43 @@
+#pragma once
+#include <slime/Math.hpp>
+
+// First order antiderivative anti-aliasing of tanh, four lanes at a time.
+// The output is the mean of tanh over the segment from the previous input to the current one,
+// (F(x) - F(x1)) / (x - x1) with F(x) = log(cosh(x)) = |x| + log(1 + exp(-2|x|)) - log(2).
+struct TanhADAA {
+	using T = slime::math::float_simd;
+
+	// Below this step the difference quotient loses too much precision in single float,
+	// tanh of the midpoint is used instead
+	static constexpr float EPSILON = 1e-3f;
+
+	T x1 = 0.0f;
+	T e1 = 1.0f; // exp(-2|x1|)
+
+	void reset() {
+		x1 = 0.0f;
+		e1 = 1.0f;
+	}
+
+	T process(T x) {
+		T ax = rack::simd::fabs(x);
+		T e = rack::simd::exp(-2.0f * ax);
+		T dx = x - x1;
+		T ill = rack::simd::fabs(dx) < EPSILON;
+
+		// The log(2) terms cancel, and the log terms are taken as one ratio to keep the precision
+		T num = (ax - rack::simd::fabs(x1)) + rack::simd::log((1.0f + e) / (1.0f + e1));
+		T y = num / rack::simd::ifelse(ill, 1.0f, dx);
+
+		if (rack::simd::movemask(ill)) {
+			T mid = 0.5f * (x + x1);
+			T em = rack::simd::exp(-2.0f * rack::simd::fabs(mid));
+			T t = (1.0f - em) / (1.0f + em);
+			y = rack::simd::ifelse(ill, rack::simd::ifelse(mid < 0.0f, -t, t), y);
+		}
+
+		x1 = x;
+		e1 = e;
+		return y;
+	}
+};
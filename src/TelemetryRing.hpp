@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+// Lock-free single producer, single consumer ring of small records, from the audio thread
+// to the UI. Each record shares its cache line with a sequence number, so publishing one
+// writes a single line and the two sides share nothing else. The producer never waits:
+// when the reader falls behind, the oldest records are overwritten and the reader skips
+// ahead. A record overwritten while it was being read is caught by its sequence number
+// and dropped, so the reader never sees a torn record.
+template <typename T, int SIZE = 16>
+struct TelemetryRing {
+	static constexpr int LINE = 64;
+	static_assert((SIZE & (SIZE - 1)) == 0, "the ring size is a power of two");
+	static_assert(std::is_trivially_copyable<T>::value, "records are copied while they may be written");
+
+	struct Slot {
+		std::atomic<uint64_t> sequence{0}; // 2n - 1 while record n is written, 2n once it is
+		T data;
+	};
+	static_assert(sizeof(Slot) <= LINE, "a record fits in a cache line with its sequence number");
+
+	// Modules aren't allocated with their alignment before C++17, so the slots are lined up
+	// with cache lines inside a larger buffer
+	unsigned char storage[(SIZE + 1) * LINE];
+	unsigned char* lines;
+	uint64_t written = 0; // owned by the producer
+	unsigned char padding[LINE];
+	uint64_t read = 0; // owned by the consumer
+
+	TelemetryRing() {
+		lines = (unsigned char*)(((uintptr_t)storage + LINE - 1) & ~(uintptr_t)(LINE - 1));
+		for (int i = 0; i < SIZE; i++)
+			new (lines + i * LINE) Slot();
+	}
+	TelemetryRing(const TelemetryRing&) = delete;
+	TelemetryRing& operator=(const TelemetryRing&) = delete;
+
+	Slot& slot(uint64_t n) {
+		return *(Slot*)(lines + (n % SIZE) * LINE);
+	}
+
+	void publish(const T& data) {
+		Slot& s = slot(written);
+		written++;
+		s.sequence.store(2 * written - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		s.data = data;
+		s.sequence.store(2 * written, std::memory_order_release);
+	}
+
+	// Takes the next record, returns false if there is none yet
+	bool pop(T* data) {
+		while (true) {
+			Slot& s = slot(read);
+			uint64_t expected = 2 * (read + 1);
+			uint64_t before = s.sequence.load(std::memory_order_acquire);
+			if (before < expected)
+				return false;
+			if (before == expected) {
+				*data = s.data;
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (s.sequence.load(std::memory_order_relaxed) == expected) {
+					read++;
+					return true;
+				}
+				continue;
+			}
+			// Lapped by the producer, carry on from the oldest record left
+			read = (before + 1) / 2 - SIZE;
+		}
+	}
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+
+// Lock-free single producer, single consumer triple buffer. The writer fills writeBuffer()
+// and publishes it, the reader picks up the most recently published value whenever it
+// wants to with update(). Neither side ever blocks, and a value is never read while it
+// is being written.
+template <typename T>
+struct TripleBuffer {
+	static constexpr int INDEX_MASK = 3;
+	static constexpr int FRESH = 4; // the middle slot holds a value the reader hasn't seen
+
+	T slots[3];
+	std::atomic<int> middle{1};
+	int front = 0; // owned by the reader
+	int back = 2; // owned by the writer
+
+	T& writeBuffer() {
+		return slots[back];
+	}
+
+	void publish() {
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Returns true if a new value was picked up
+	bool update() {
+		if (!(middle.load(std::memory_order_acquire) & FRESH))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	const T& read() const {
+		return slots[front];
+	}
+};
@@ -0,0 +1,142 @@
+#include "Wavetable.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+
+#include <rack.hpp>
+
+static uint32_t readU32(const uint8_t* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t readU16(const uint8_t* p) {
+	return p[0] | (p[1] << 8);
+}
+
+// Samples of a mono WAV file, false if it isn't one this can read
+static bool readWav(const std::string& path, std::vector<float>* samples) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (bytes.size() < 12 || std::memcmp(&bytes[0], "RIFF", 4) != 0 || std::memcmp(&bytes[8], "WAVE", 4) != 0)
+		return false;
+
+	int format = 0, channels = 0, bits = 0;
+	size_t pos = 12;
+	while (pos + 8 <= bytes.size()) {
+		uint32_t size = readU32(&bytes[pos + 4]);
+		const uint8_t* chunk = &bytes[pos + 8];
+		if (size > bytes.size() - pos - 8)
+			return false;
+		if (std::memcmp(&bytes[pos], "fmt ", 4) == 0 && size >= 16) {
+			format = readU16(chunk);
+			channels = readU16(chunk + 2);
+			bits = readU16(chunk + 14);
+		} else if (std::memcmp(&bytes[pos], "data", 4) == 0) {
+			if (channels != 1)
+				return false;
+			if (format == 3 && bits == 32) {
+				samples->resize(size / 4);
+				std::memcpy(samples->data(), chunk, samples->size() * 4);
+			} else if (format == 1 && bits == 16) {
+				samples->resize(size / 2);
+				for (size_t i = 0; i < samples->size(); i++)
+					(*samples)[i] = (int16_t)readU16(chunk + i * 2) / 32768.0f;
+			} else {
+				return false;
+			}
+			return true;
+		}
+		// Chunks are padded to an even size
+		pos += 8 + size + (size & 1);
+	}
+	return false;
+}
+
+std::shared_ptr<const Wavetable> Wavetable::load(const std::string& path, int frame_size) {
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<const Wavetable>> cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<const Wavetable> table = cache[path].lock();
+	if (table)
+		return table;
+
+	std::vector<float> samples;
+	if (!readWav(path, &samples)) {
+		WARN("Can't read wavetable %s", path.c_str());
+		return nullptr;
+	}
+	if (frame_size < MIN_LEVEL_SIZE || (frame_size & (frame_size - 1)) || samples.size() < (size_t)frame_size
+		|| samples.size() % frame_size) {
+		WARN("Wavetable %s isn't made of %d sample frames", path.c_str(), frame_size);
+		return nullptr;
+	}
+
+	std::shared_ptr<Wavetable> built = std::make_shared<Wavetable>();
+	built->build(samples, frame_size);
+	cache[path] = built;
+	DEBUG("Loaded wavetable %s, %d frames", path.c_str(), built->frames);
+	return built;
+}
+
+void Wavetable::build(const std::vector<float>& samples, int frame_size) {
+	this->frame_size = frame_size;
+	frames = samples.size() / frame_size;
+
+	levels.clear();
+	size_t offset = 0;
+	for (int harmonics = frame_size / 2; harmonics >= 1; harmonics /= 2) {
+		// The first level is the frame itself, the others are resampled to SAMPLES_PER_CYCLE
+		// samples per cycle of their top harmonic, for a clean linear interpolation
+		int size = levels.empty() ? frame_size : std::max(SAMPLES_PER_CYCLE * harmonics, (int)MIN_LEVEL_SIZE);
+		levels.push_back({size, harmonics, offset});
+		offset += (size_t)frames * (size + 1);
+	}
+	data.assign(offset, 0.0f);
+
+	int max_size = 0;
+	for (const Level& level : levels)
+		max_size = std::max(max_size, level.size);
+	float* input = rack::dsp::alignedNew<float>(frame_size);
+	float* spectrum = rack::dsp::alignedNew<float>(frame_size);
+	float* level_spectrum = rack::dsp::alignedNew<float>(max_size);
+	float* output = rack::dsp::alignedNew<float>(max_size);
+	rack::dsp::RealFFT analysis(frame_size);
+	std::vector<std::unique_ptr<rack::dsp::RealFFT>> synthesis;
+	for (const Level& level : levels)
+		synthesis.emplace_back(new rack::dsp::RealFFT(level.size));
+
+	for (int frame = 0; frame < frames; frame++) {
+		std::copy(&samples[(size_t)frame * frame_size], &samples[(size_t)(frame + 1) * frame_size], input);
+		analysis.rfft(input, spectrum);
+
+		for (size_t l = 0; l < levels.size(); l++) {
+			const Level& level = levels[l];
+			float* row = &data[level.offset + (size_t)frame * (level.size + 1)];
+			if (l == 0) {
+				std::copy(input, input + frame_size, row);
+			} else {
+				// Same harmonics resynthesized over `size` samples, in the layout of RealFFT:
+				// DC, Nyquist, then real and imaginary parts of each harmonic
+				std::fill(level_spectrum, level_spectrum + level.size, 0.0f);
+				level_spectrum[0] = spectrum[0];
+				std::copy(spectrum + 2, spectrum + 2 * (level.harmonics + 1), level_spectrum + 2);
+				synthesis[l]->irfft(level_spectrum, output);
+				for (int i = 0; i < level.size; i++)
+					row[i] = output[i] / frame_size;
+			}
+			row[level.size] = row[0];
+		}
+	}
+
+	rack::dsp::alignedDelete(input);
+	rack::dsp::alignedDelete(spectrum);
+	rack::dsp::alignedDelete(level_spectrum);
+	rack::dsp::alignedDelete(output);
+}
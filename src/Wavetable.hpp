@@ -0,0 +1,39 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+// A wavetable file cut into frames, each frame resynthesized at levels of decreasing
+// bandwidth so it can be played at any pitch without aliasing: level k keeps the lowest
+// frame_size / 2 >> k harmonics, in enough samples to interpolate them linearly.
+//
+// Tables are read only once built, and shared by every module of the process that loads
+// the same file. The cache only holds weak references, so a table is freed when the last
+// module using it goes away.
+struct Wavetable {
+	static constexpr int MIN_LEVEL_SIZE = 64;
+	static constexpr int SAMPLES_PER_CYCLE = 8;
+
+	struct Level {
+		int size; // samples per frame, each row has one more repeating the first
+		int harmonics;
+		size_t offset; // of the first row in data
+	};
+
+	int frames = 0;
+	int frame_size = 0;
+	std::vector<Level> levels;
+	std::vector<float> data;
+
+	const float* row(int level, int frame) const {
+		const Level& l = levels[level];
+		return &data[l.offset + (size_t)frame * (l.size + 1)];
+	}
+
+	// Mono 32 bit float or 16 bit WAV, `frame_size` samples per frame. Returns null, after
+	// logging why, if the file can't be read. Not for the audio thread.
+	static std::shared_ptr<const Wavetable> load(const std::string& path, int frame_size);
+
+	// Builds the levels from the samples of every frame, one after the other
+	void build(const std::vector<float>& samples, int frame_size);
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <rack.hpp>
+
+#include <slime/Math.hpp>
+
+#include "Wavetable.hpp"
+
+// Four voices of a wavetable oscillator. Each voice plays the level of the table that has
+// no harmonic above Nyquist at its pitch, and crossfades between the two frames nearest
+// its pitch: frames are one semitone apart from FIRST_FRAME_PITCH, so the wave changes
+// shape with the note the way the 303 VCO it was sampled from does.
+struct WavetableOscillator {
+	using float_simd = slime::math::float_simd;
+
+	static constexpr float FIRST_FRAME_PITCH = -3.0f; // C1, in volts from C4
+	static constexpr float GAIN = 10.0f; // tables peak around 0.5
+
+	float_simd phase = 0.0f;
+
+	void reset() {
+		phase = 0.0f;
+	}
+
+	// `pitch` in volts per octave from C4
+	float_simd process(const Wavetable& table, float_simd pitch, float sample_time) {
+		float_simd freq = rack::dsp::FREQ_C4 * rack::dsp::approxExp2_taylor5<float_simd>(pitch);
+		float_simd increment = rack::simd::clamp(freq * sample_time, 0.0f, 0.5f);
+		phase += increment;
+		phase -= rack::simd::floor(phase);
+
+		float_simd position = rack::simd::clamp((pitch - FIRST_FRAME_PITCH) * 12.0f, 0.0f, (float)(table.frames - 1));
+		float_simd first_frame = rack::simd::floor(position);
+		float_simd fade = position - first_frame;
+
+		// Table lookups are per voice, the interpolation is done on all four at once
+		float a[float_simd::size], b[float_simd::size], c[float_simd::size], d[float_simd::size], t[float_simd::size];
+		int last_level = (int)table.levels.size() - 1;
+		for (int lane = 0; lane < float_simd::size; lane++) {
+			// Level k has frame_size / 2 >> k harmonics, the lowest one keeping them under Nyquist
+			float cycles = table.frame_size * increment[lane];
+			int level = (cycles < 1.0f) ? 0 : std::min(std::ilogb(cycles) + 1, last_level);
+			int size = table.levels[level].size;
+			float x = phase[lane] * size;
+			int i = std::min((int)x, size - 1);
+			t[lane] = x - i;
+
+			int frame = (int)first_frame[lane];
+			const float* row1 = table.row(level, frame);
+			const float* row2 = table.row(level, std::min(frame + 1, table.frames - 1));
+			a[lane] = row1[i];
+			b[lane] = row1[i + 1];
+			c[lane] = row2[i];
+			d[lane] = row2[i + 1];
+		}
+
+		float_simd frac = float_simd::load(t);
+		float_simd v1 = float_simd::load(a) + (float_simd::load(b) - float_simd::load(a)) * frac;
+		float_simd v2 = float_simd::load(c) + (float_simd::load(d) - float_simd::load(c)) * frac;
+		return GAIN * (v1 + (v2 - v1) * fade);
+	}
+};
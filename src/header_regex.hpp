@@ -1,3 +0,0 @@
-#include <regex>
-
-bool header_search(const char* str, std::cmatch* cm);
\ No newline at end of file